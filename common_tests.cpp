@@ -10,8 +10,25 @@
         1. delete key
         2. delete non existent key
     4. Invalid key | value
+        1. status returning calls
     4. create(TTL)
+        1. TTL in seconds
+        2. TTL in milliseconds
+        3. background reaper
+        4. reaping in slices
+        5. TTL jitter
     5. batch create
+    6. value encodings
+    7. value deduplication
+    8. value compression
+    9. capacity
+        1. runtime capacity
+        2. following the cgroup's memory
+    10. value views
+    11. huge pages
+    12. defragmentation
+    13. eviction policies
+    14. miss ratio curve
 */
 #include "json.hpp"
 #include <iostream>
@@ -19,6 +36,10 @@
 #include <unistd.h>
 #include <string>
 #include <ctime>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+#include <climits>
 
 using std::endl, std::cout, std::string, std::cerr;
 
@@ -26,7 +47,19 @@ void getKeyTests(string key, string value, KVcache &kv);
 void deleteKeyTests(string key, KVcache &kv);
 void invalidPutTest(KVcache &kv);
 void TTLTests(string key, string value, KVcache &kv);
+void reaperTests();
+void reapSliceTests();
+void jitterTests();
 void batchCreateTests(KVcache &kv);
+void encodingTests(string key, string value);
+void dedupTests(string value);
+void compressionTests();
+void capacityTests();
+void viewTests(string value);
+void hugePageTests(string value);
+void defragTests();
+void evictionPolicyTests();
+void missRatioCurveTests();
 
 int main(int argc, char *argv[])
 {
@@ -51,8 +84,32 @@ int main(int argc, char *argv[])
 
     TTLTests(key, value, kv);
 
+    reaperTests();
+
+    reapSliceTests();
+
+    jitterTests();
+
     batchCreateTests(kv);
 
+    encodingTests(key, value);
+
+    dedupTests(value);
+
+    compressionTests();
+
+    capacityTests();
+
+    viewTests(value);
+
+    hugePageTests(value);
+
+    defragTests();
+
+    evictionPolicyTests();
+
+    missRatioCurveTests();
+
     return 0;
 }
 
@@ -127,6 +184,18 @@ void invalidPutTest(KVcache &kv)
         } });
 
     cout << "\033[32mCreating invalid json test passed.\033[0m" << endl;
+
+    // the status returning calls
+    Status tooLong = kv.tryPutKey("Too long key Too long key Too long key", "value");
+    Status created = kv.tryPutKey("status key", R"({"status" : "ok"})");
+    Status deleted = kv.tryDeleteKey("status key");
+    Status missing = kv.tryDeleteKey("status key");
+    if (tooLong || tooLong.code != Error_code::KEY_TOO_LONG || !created || !deleted || missing || missing.code != Error_code::KEY_NOT_FOUND)
+    {
+        throw "\033[31mStatus test failed.\033[0m";
+    }
+
+    cout << "\033[32mStatus test passed.\033[0m" << endl;
 }
 
 void TTLTests(string key, string value, KVcache &kv)
@@ -148,6 +217,8 @@ void TTLTests(string key, string value, KVcache &kv)
         cout << i << " " << std::flush;
         sleep(1);
     }
+    // deadlines are rounded up by a tick of the cached clock
+    usleep(10 * 1000);
 
     // fetching the key after 3 seconds
     j = kv.getKey(key);
@@ -158,6 +229,185 @@ void TTLTests(string key, string value, KVcache &kv)
     }
 
     cout << "\n\033[32mTTL test passed.\033[0m" << endl;
+
+    // inserting the data with a TTL in milliseconds
+    kv.putKey(key, value, std::chrono::milliseconds(200));
+    cout << "Created key : " << key << " with a 200 milliseconds TTL" << endl;
+
+    usleep(100 * 1000);
+    if (kv.getKey(key).dump() != value)
+    {
+        throw "\033[31mTTL(ms) test failed.\033[0m";
+    }
+
+    usleep(150 * 1000);
+    if (kv.getKey(key).dump() != "{}")
+    {
+        throw "\033[31mTTL(ms) test failed.\033[0m";
+    }
+
+    cout << "\033[32mTTL(ms) test passed.\033[0m" << endl;
+
+    // a key never expires before its TTL, give or take the cached clock's one tick of slack
+    auto put = std::chrono::steady_clock::now();
+    kv.putKey(key, value, std::chrono::milliseconds(20));
+    while (kv.getKeyView(key))
+    {
+    }
+    if (std::chrono::steady_clock::now() - put < std::chrono::milliseconds(19))
+    {
+        throw "\033[31mTTL(ms) test failed.\033[0m";
+    }
+
+    // the clock keeps moving while a long batch holds the lock, the key is gone once it is released
+    KVcache locked("locked-store-" + std::to_string(time(nullptr)) + ".json");
+    int n = 50000;
+    std::vector<KVE> val(n);
+    for (int i = 0; i < n; i++)
+    {
+        val[i].key = "key" + std::to_string(i);
+        val[i].data = i;
+    }
+
+    put = std::chrono::steady_clock::now();
+    locked.putKey(key, value, std::chrono::milliseconds(300));
+    std::thread batch([&]()
+                      { locked.batchCreate(n, val.data(), [](std::vector<Error_obj>) {}); });
+    usleep(50 * 1000);
+    string read = locked.getKeyText(key);
+    bool late = std::chrono::steady_clock::now() - put > std::chrono::milliseconds(310);
+    batch.join();
+
+    if (late && read != "{}")
+    {
+        throw "\033[31mTTL during a locked operation test failed.\033[0m";
+    }
+
+    cout << "\033[32mTTL during a locked operation test passed.\033[0m" << endl;
+}
+
+// keys held in a data-store file
+json readStore(string file)
+{
+    std::ifstream in(file);
+    string content;
+    getline(in, content);
+    return content.empty() ? json::object() : json::parse(content);
+}
+
+void reaperTests()
+{
+    // Tests for the background reaper
+    cout << "----------------reaper-------------------" << endl;
+
+    // expired keys nobody reads are removed, and the data-store rewritten, by the reaper alone
+    string file = "reaper-store-" + std::to_string(time(nullptr)) + ".json";
+    KVcache kv(file);
+    int n = 100;
+    KVE val[n];
+    for (int i = 0; i < n; i++)
+    {
+        val[i].key = "key" + std::to_string(i);
+        val[i].data = i;
+        val[i].expiryMs = i ? 50 : -1;
+    }
+    kv.batchCreate(n, val, [](std::vector<Error_obj>) {});
+    usleep(300 * 1000);
+
+    if (readStore(file).size() != 1 || !readStore(file).contains("key0") || !kv.validate())
+    {
+        throw "\033[31mReaper test failed.\033[0m";
+    }
+
+    cout << "\033[32mReaper test passed.\033[0m" << endl;
+}
+
+void reapSliceTests()
+{
+    // Tests for reaping in slices
+    cout << "----------------reaping in slices-------------------" << endl;
+
+    // while many keys expire at once, reads get the lock between two slices of reapSliceKeys keys
+    KVconfig config;
+    config.reapSliceKeys = 16;
+    config.reapSliceMicros = 200;
+    string slicedFile = "sliced-store-" + std::to_string(time(nullptr)) + ".json";
+    KVcache sliced(slicedFile, config);
+
+    int n = 20000;
+    std::vector<KVE> many(n);
+    for (int i = 0; i < n; i++)
+    {
+        many[i].key = "key" + std::to_string(i);
+        many[i].data = i;
+        many[i].expiryMs = 500;
+    }
+    auto start = std::chrono::steady_clock::now();
+    sliced.batchCreate(n, many.data(), [](std::vector<Error_obj>) {});
+    sliced.putKey("probe", "1");
+    std::this_thread::sleep_until(start + std::chrono::milliseconds(500));
+
+    auto longest = std::chrono::steady_clock::duration::zero();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2500))
+    {
+        auto before = std::chrono::steady_clock::now();
+        sliced.getKeyView("probe");
+        longest = std::max(longest, std::chrono::steady_clock::now() - before);
+    }
+
+    if (longest > std::chrono::milliseconds(20) || readStore(slicedFile).size() != 1 || !sliced.validate())
+    {
+        throw "\033[31mReaper slice test failed.\033[0m";
+    }
+
+    cout << "\033[32mReaper slice test passed.\033[0m" << endl;
+}
+
+void jitterTests()
+{
+    // Tests for the TTL jitter
+    cout << "----------------TTL jitter-------------------" << endl;
+
+    KVconfig config;
+    config.ttlJitterPercent = 50;
+    config.ttlJitterMs = 200;
+    string file = "jitter-store-" + std::to_string(time(nullptr)) + ".json";
+    KVcache kv(file, config);
+
+    // deadlines of keys created together spread over [ttl, ttl + ttl * 50 / 100 + 200]
+    int n = 1000;
+    long long ttl = 10000, window = ttl * 50 / 100 + 200;
+    KVE val[n];
+    for (int i = 0; i < n; i++)
+    {
+        val[i].key = "key" + std::to_string(i);
+        val[i].data = i;
+        val[i].expiryMs = ttl;
+    }
+
+    auto wallClock = []()
+    { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(); };
+    long long before = wallClock();
+    kv.batchCreate(n, val, [](std::vector<Error_obj>) {});
+    long long after = wallClock();
+
+    // the data-store keeps deadlines as unix time in ms, converted from the monotonic clock, deadlines
+    // are rounded up by a tick of the cached clock
+    json store = readStore(file);
+    long long earliest = LLONG_MAX, latest = LLONG_MIN;
+    for (auto &entry : store)
+    {
+        long long expiry = entry["expiryMs"].get<long long>();
+        earliest = std::min(earliest, expiry);
+        latest = std::max(latest, expiry);
+    }
+
+    if (earliest < before + ttl - 2 || latest > after + ttl + window + 3 || latest - earliest < window / 2)
+    {
+        throw "\033[31mTTL jitter test failed.\033[0m";
+    }
+
+    cout << "\033[32mTTL jitter test passed.\033[0m" << endl;
 }
 
 void batchCreateTests(KVcache &kv)
@@ -197,4 +447,470 @@ void batchCreateTests(KVcache &kv)
     }
 
     cout << "\033[32mBatch create test passed.\033[0m" << endl;
-}
\ No newline at end of file
+}
+
+void encodingTests(string key, string value)
+{
+    // Tests for the binary value encodings
+    cout << "----------------value encodings-------------------" << endl;
+
+    ValueEncoding encodings[] = {ValueEncoding::MSGPACK, ValueEncoding::CBOR};
+    for (ValueEncoding encoding : encodings)
+    {
+        KVconfig config;
+        config.valueEncoding = encoding;
+        KVcache kv("encoding-store-" + std::to_string(encoding) + "-" + std::to_string(time(nullptr)) + ".json", config);
+
+        kv.putKey(key, value);
+        kv.putJson(key + "-json", json::parse(value));
+        if (kv.getKey(key).dump() != value || kv.getKeyText(key) != value || kv.getKeyText(key + "-json") != value)
+        {
+            throw "\033[31mValue encoding test failed.\033[0m";
+        }
+    }
+
+    cout << "\033[32mValue encoding test passed.\033[0m" << endl;
+}
+
+void dedupTests(string value)
+{
+    // Tests for value deduplication
+    cout << "----------------value dedup-------------------" << endl;
+
+    KVconfig config;
+    config.dedupValues = true;
+    KVcache kv("dedup-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    // two keys sharing one stored value
+    kv.putKey("first", value);
+    kv.putKey("second", value);
+
+    // deleting one of them must keep the shared value alive for the other
+    kv.deleteKey("first");
+    if (kv.getKey("first").dump() != "{}" || kv.getKey("second").dump() != value || !kv.validate())
+    {
+        throw "\033[31mValue dedup test failed.\033[0m";
+    }
+
+    cout << "\033[32mValue dedup test passed.\033[0m" << endl;
+}
+
+void compressionTests()
+{
+    // Tests for value compression
+    cout << "----------------value compression-------------------" << endl;
+
+    KVconfig config;
+    config.compressAbove = 64;
+    KVcache kv("compression-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    // a large repetitive value is stored compressed, a small one as is
+    json big;
+    for (int i = 0; i < 64; i++)
+    {
+        big["field" + std::to_string(i)] = "Lorem Ipsum";
+    }
+    kv.putKey("big", big.dump());
+    kv.putKey("small", R"({"a":1})");
+
+    if (kv.getKey("big") != big || kv.getKey("small").dump() != R"({"a":1})" || !kv.validate())
+    {
+        throw "\033[31mValue compression test failed.\033[0m";
+    }
+
+    cout << "\033[32mValue compression test passed.\033[0m" << endl;
+}
+
+void capacityTests()
+{
+    // Tests for the capacity
+    cout << "----------------capacity-------------------" << endl;
+
+    KVcache kv("capacity-store-" + std::to_string(time(nullptr)) + ".json");
+    for (int i = 0; i < 1000; i++)
+    {
+        kv.putKey("key" + std::to_string(i), R"({"capacity" : "Lorem Ipsum"})");
+    }
+
+    // shrinking evicts the least recently used keys
+    kv.setCapacity(16 * 1024);
+    if (kv.getCapacity() != 16 * 1024 || kv.getKey("key0").dump() != "{}" || kv.getKey("key999").dump() == "{}" || !kv.validate())
+    {
+        throw "\033[31mRuntime capacity test failed.\033[0m";
+    }
+
+    // an entry bigger than the capacity is kept on its own
+    kv.setCapacity(100);
+    kv.putKey("large", R"({"capacity" : "Lorem Ipsum"})");
+    if (kv.getKey("key999").dump() != "{}" || kv.getKey("large").dump() == "{}" || !kv.validate())
+    {
+        throw "\033[31mRuntime capacity test failed.\033[0m";
+    }
+
+    cout << "\033[32mRuntime capacity test passed.\033[0m" << endl;
+
+    // a cgroup over its limit shrinks the cache until the memory it gives back brings the cgroup
+    // under the limit. The fake cgroup's usage follows the memory the cache holds.
+    string cgroup = "cgroup-" + std::to_string(time(nullptr));
+    mkdir(cgroup.c_str(), 0755);
+    std::ofstream(cgroup + "/memory.max") << "max" << endl;
+    std::ofstream(cgroup + "/memory.current") << 0 << endl;
+
+    KVconfig config;
+    config.followMemoryPressure = true;
+    config.cgroupPath = cgroup;
+    config.memoryCheckIntervalMs = 10;
+    config.memoryHeadroomPercent = 0;
+    config.minCapacity = 1024 * 1024;
+    KVcache monitored("monitored-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    int n = 2500;
+    std::vector<KVE> val(n);
+    for (int i = 0; i < n; i++)
+    {
+        val[i].key = "key" + std::to_string(i);
+        val[i].data = string(4000, 'x');
+    }
+    monitored.batchCreate(n, val.data(), [](std::vector<Error_obj>) {});
+
+    long long others = 50 * 1024 * 1024, over = 4 * 1024 * 1024;
+    std::atomic<bool> tracking = true;
+    std::thread usage([&]()
+                      {
+        while (tracking)
+        {
+            std::ofstream(cgroup + "/memory.current.tmp") << others + monitored.memoryStats().resident << endl;
+            rename((cgroup + "/memory.current.tmp").c_str(), (cgroup + "/memory.current").c_str());
+            usleep(2 * 1000);
+        } });
+    long long filled = monitored.memoryStats().used;
+    std::ofstream(cgroup + "/memory.max.tmp") << others + monitored.memoryStats().resident - over << endl;
+    rename((cgroup + "/memory.max.tmp").c_str(), (cgroup + "/memory.max").c_str());
+    usleep(1000 * 1000);
+    tracking = false;
+    usage.join();
+
+    long long capacity = monitored.getCapacity();
+    bool shrunk = capacity < filled - over / 2 && capacity > filled - 2 * over && monitored.getKey("key0").dump() == "{}" &&
+                  monitored.getKey("key2499").dump() != "{}" && monitored.validate();
+    unlink((cgroup + "/memory.max").c_str());
+    unlink((cgroup + "/memory.current").c_str());
+    rmdir(cgroup.c_str());
+
+    if (!shrunk)
+    {
+        throw "\033[31mMemory pressure capacity test failed.\033[0m";
+    }
+
+    cout << "\033[32mMemory pressure capacity test passed.\033[0m" << endl;
+}
+
+void viewTests(string value)
+{
+    // Tests for value views
+    cout << "----------------value views-------------------" << endl;
+
+    KVcache kv("view-store-" + std::to_string(time(nullptr)) + ".json");
+    kv.putKey("viewed", value);
+
+    // the view keeps the value readable after its key is deleted
+    ValueView view = kv.getKeyView("viewed");
+    kv.deleteKey("viewed");
+    if (!view || view.bytes() != value || view.value().dump() != value || kv.getKeyView("viewed") || !kv.validate())
+    {
+        throw "\033[31mValue view test failed.\033[0m";
+    }
+
+    cout << "\033[32mValue view test passed.\033[0m" << endl;
+}
+
+void hugePageTests(string value)
+{
+    // Tests for the huge page backed heap, huge pages are used if the system has any
+    cout << "----------------huge pages-------------------" << endl;
+
+    KVconfig config;
+    config.hugePages = true;
+    KVcache kv("huge-page-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        kv.putKey("key" + std::to_string(i), value);
+    }
+    if (kv.getKey("key0").dump() != value || kv.getKey("key999").dump() != value || !kv.validate())
+    {
+        throw "\033[31mHuge page test failed.\033[0m";
+    }
+
+    cout << "\033[32mHuge page test passed.\033[0m" << endl;
+}
+
+// bytes of slab pages left empty once most values of a few pages were deleted, the kept values
+// being checked intact. -1 if a value was damaged.
+long long emptiedBytes(bool defragment)
+{
+    KVconfig config;
+    config.defragment = defragment;
+    config.defragIntervalMs = 10;
+    KVcache kv(string(defragment ? "defrag" : "fragmented") + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    // filling a few slab pages and freeing most of their chunks
+    int n = 500;
+    KVE val[n];
+    for (int i = 0; i < n; i++)
+    {
+        val[i].key = "key" + std::to_string(i);
+        val[i].data = {{"defrag", string(8000 + i % 50, 'x')}};
+    }
+    kv.batchCreate(n, val, [](std::vector<Error_obj>) {});
+    for (int i = 0; i < n; i++)
+    {
+        if (i % 10)
+        {
+            kv.deleteKey(val[i].key);
+        }
+    }
+
+    // the values moved by the defragmenter must be intact
+    usleep(100 * 1000);
+    for (int i = 0; i < n; i += 10)
+    {
+        if (kv.getKey(val[i].key) != val[i].data)
+        {
+            return -1;
+        }
+    }
+    return kv.validate() ? kv.memoryStats().emptyPages : -1;
+}
+
+void defragTests()
+{
+    // Tests for the slab defragmentation
+    cout << "----------------defragmentation-------------------" << endl;
+
+    // the values left in sparsely used pages are packed into fewer pages
+    long long fragmented = emptiedBytes(false), defragmented = emptiedBytes(true);
+    if (fragmented != 0 || defragmented < 2 * (1 << 20))
+    {
+        throw "\033[31mDefragmentation test failed.\033[0m";
+    }
+
+    cout << "\033[32mDefragmentation test passed.\033[0m" << endl;
+}
+
+// first of "old" and "read" to be evicted once entries are added to a full cache, "read" having
+// been read after both were added
+template <class EvictionPolicy>
+string firstEvicted(string name, string readValue = "1", uint32_t oldCostHint = 1)
+{
+    KVconfig config;
+    config.capacity = 32 * 1024;
+    BasicKVcache<EvictionPolicy> kv(name + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    kv.putKey("read", readValue);
+    kv.tryPutKey("old", "2", std::chrono::milliseconds(-1), oldCostHint);
+    kv.getKey("read");
+
+    // a put of an existing key fails without counting as an access
+    for (int i = 0; i < 1000; i++)
+    {
+        kv.putKey("filler" + std::to_string(i), "3");
+        if (kv.tryPutKey("old", "2"))
+        {
+            return "old";
+        }
+        if (kv.tryPutKey("read", readValue))
+        {
+            return "read";
+        }
+    }
+    return "";
+}
+
+// number of 10 frequently read keys still cached after a scan of one-off keys through a full
+// cache, the keys being put back whenever they are missing
+template <class EvictionPolicy>
+int hotKeysKept(string name)
+{
+    KVconfig config;
+    config.capacity = 16 * 1024;
+    BasicKVcache<EvictionPolicy> kv(name + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    for (int i = 0; i < 200; i++)
+    {
+        kv.putKey("fill" + std::to_string(i), "0");
+    }
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            if (!kv.getKeyView("hot" + std::to_string(i)))
+            {
+                kv.putKey("hot" + std::to_string(i), "1");
+            }
+        }
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        kv.putKey("scan" + std::to_string(i), "2");
+    }
+
+    int kept = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        kept += kv.getKeyView("hot" + std::to_string(i)) ? 1 : 0;
+    }
+    return kv.validate() ? kept : -1;
+}
+
+// whether a key put back right after a scan evicted it survives a second scan, without ever being
+// read. A few read keys keep part of the cache for entries seen more than once.
+template <class EvictionPolicy>
+bool returningKeyKept(string name)
+{
+    KVconfig config;
+    config.capacity = 16 * 1024;
+    BasicKVcache<EvictionPolicy> kv(name + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    for (int i = 0; i < 10; i++)
+    {
+        kv.putKey("hot" + std::to_string(i), "0");
+        kv.getKey("hot" + std::to_string(i));
+    }
+
+    // a put of an existing key fails, the first one to succeed puts the key back
+    kv.putKey("returning", "1");
+    for (int i = 0; i < 1000 && !kv.tryPutKey("returning", "1"); i++)
+    {
+        kv.putKey("scan" + std::to_string(i), "2");
+    }
+    for (int i = 1000; i < 2000; i++)
+    {
+        kv.putKey("scan" + std::to_string(i), "2");
+    }
+    return kv.tryPutKey("returning", "1").code == KEY_ALREADY_EXISTS && kv.validate();
+}
+
+// number of 10 keys, read after 100 keys were added, still cached once 150 more keys are added
+template <class EvictionPolicy>
+int recentlyReadKept(string name)
+{
+    KVconfig config;
+    config.capacity = 32 * 1024;
+    BasicKVcache<EvictionPolicy> kv(name + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    for (int i = 0; i < 100; i++)
+    {
+        kv.putKey("key" + std::to_string(i), "0");
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        kv.getKey("key" + std::to_string(i));
+    }
+    for (int i = 0; i < 150; i++)
+    {
+        kv.putKey("new" + std::to_string(i), "1");
+    }
+
+    int kept = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        kept += kv.getKeyView("key" + std::to_string(i)) ? 1 : 0;
+    }
+    return kv.validate() ? kept : -1;
+}
+
+// whether an expensive entry put while the capacity was below one entry outlives 1000 cheap
+// entries put once the capacity is raised. Keeping the lone entry evicts nothing, so it must not
+// raise GDSF's inflation value, which would score every later entry above it.
+template <class EvictionPolicy>
+bool loneEntryKept(string name)
+{
+    KVconfig config;
+    config.capacity = 100;
+    BasicKVcache<EvictionPolicy> kv(name + "-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    kv.tryPutKey("costly", "1", std::chrono::milliseconds(-1), 1000);
+    kv.setCapacity(32 * 1024);
+    for (int i = 0; i < 1000; i++)
+    {
+        kv.putKey("filler" + std::to_string(i), "2");
+    }
+    return kv.tryPutKey("costly", "1").code == KEY_ALREADY_EXISTS && kv.validate();
+}
+
+void evictionPolicyTests()
+{
+    // Tests for the eviction policies
+    cout << "----------------eviction policies-------------------" << endl;
+
+    if (firstEvicted<LRUPolicy>("lru") != "old" || firstEvicted<FIFOPolicy>("fifo") != "read" ||
+        hotKeysKept<LRUPolicy>("lru-scan") != 0 || hotKeysKept<WTinyLFUPolicy>("tinylfu-scan") != 10 ||
+        hotKeysKept<ARCPolicy>("arc-scan") != 10 || returningKeyKept<LRUPolicy>("lru-ghost") ||
+        !returningKeyKept<ARCPolicy>("arc-ghost"))
+    {
+        throw "\033[31mEviction policy test failed.\033[0m";
+    }
+
+    // the large value, then the value that is cheap to recompute, goes first despite being read
+    string large = '"' + string(8000, 'x') + '"';
+    if (firstEvicted<LRUPolicy>("lru-size", large) != "old" || firstEvicted<GDSFPolicy>("gdsf-size", large) != "read" ||
+        firstEvicted<LRUPolicy>("lru-cost", "1", 1000) != "old" || firstEvicted<GDSFPolicy>("gdsf-cost", "1", 1000) != "read" ||
+        loneEntryKept<LRUPolicy>("lru-lone") || !loneEntryKept<GDSFPolicy>("gdsf-lone"))
+    {
+        throw "\033[31mEviction policy test failed.\033[0m";
+    }
+
+    // sampling finds the older entries to evict
+    if (recentlyReadKept<FIFOPolicy>("fifo-read") != 0 || recentlyReadKept<SampledLRUPolicy<>>("sampled-read") != 10)
+    {
+        throw "\033[31mEviction policy test failed.\033[0m";
+    }
+
+    // a policy kvcache.cpp does not instantiate is instantiated here
+    if (recentlyReadKept<SampledLRUPolicy<8>>("sampled8-read") != 10)
+    {
+        throw "\033[31mEviction policy test failed.\033[0m";
+    }
+
+    cout << "\033[32mEviction policy test passed.\033[0m" << endl;
+}
+
+void missRatioCurveTests()
+{
+    // Tests for the hit ratio estimate
+    cout << "----------------miss ratio curve-------------------" << endl;
+
+    KVconfig config;
+    config.mrcSampleRate = 1;
+    KVcache kv("mrc-store-" + std::to_string(time(nullptr)) + ".json", config);
+
+    // reading 1000 keys in a loop hits only if all of them(some 200 KB) fit
+    for (int i = 1000; i < 2000; i++)
+    {
+        kv.putKey("key" + std::to_string(i), "1");
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 1000; i < 2000; i++)
+        {
+            kv.getKeyView("key" + std::to_string(i));
+        }
+    }
+    if (kv.estimateHitRatio(64 * 1024) != 0 || kv.estimateHitRatio(1024 * 1024) != 1 || !kv.validate())
+    {
+        throw "\033[31mMiss ratio curve test failed.\033[0m";
+    }
+
+    // keys never stored miss whatever the capacity
+    for (int i = 0; i < 2000; i++)
+    {
+        kv.getKeyView("missing" + std::to_string(i));
+    }
+    if (kv.estimateHitRatio(1024 * 1024) != 0.5)
+    {
+        throw "\033[31mMiss ratio curve test failed.\033[0m";
+    }
+
+    cout << "\033[32mMiss ratio curve test passed.\033[0m" << endl;
+}
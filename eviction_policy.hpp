@@ -0,0 +1,749 @@
+#ifndef EVICTION_POLICY_HPP
+#define EVICTION_POLICY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "node.hpp"
+#include "node_arena.hpp"
+#include "hash_index.hpp"
+#include "frequency_sketch.hpp"
+
+// Eviction policies decide which entry leaves the cache when it runs over its capacity.
+//
+// A policy is plugged into BasicKVcache as a template parameter, so its hooks are resolved at
+// compile time. It is built from the cache's node arena and key index and provides
+//     static constexpr size_t ENTRY_BYTES  bytes of bookkeeping per entry, charged to the capacity
+//     void onInsert(Node *node)            a node was added
+//     void onAccess(Node *node)            a node was read
+//     void onRemove(Node *node)            a node was deleted, expired or evicted
+//     Node *selectVictim()                 the node to evict next, nullptr if there is none
+//     bool check(size_t entries)           validates the policy's bookkeeping
+// Hooks run under the cache's lock.
+
+// Circular doubly linked lists of node ids, all sharing one array of links indexed by node id.
+// A node is on at most one of the lists at a time.
+class IdLists
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    // list i's head takes id HEAD + i, far above any node id
+    static constexpr uint32_t HEAD = 0xFFFFFF00;
+
+    struct Link
+    {
+        uint32_t next, prev;
+    };
+
+    std::vector<Link> links; // by node id
+    std::vector<uint8_t> owner;
+    std::vector<Link> heads;
+    std::vector<size_t> sizes;
+
+    Link &at(uint32_t id)
+    {
+        return id >= HEAD ? heads[id - HEAD] : links[id];
+    }
+
+public:
+    explicit IdLists(size_t count) : heads(count), sizes(count, 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            heads[i] = {uint32_t(HEAD + i), uint32_t(HEAD + i)};
+        }
+    }
+
+    void pushFront(size_t list, uint32_t id)
+    {
+        if (id >= links.size())
+        {
+            links.resize(id + 1);
+            owner.resize(id + 1);
+        }
+
+        Link &head = heads[list];
+        links[id] = {head.next, uint32_t(HEAD + list)};
+        at(head.next).prev = id;
+        head.next = id;
+        owner[id] = list;
+        sizes[list]++;
+    }
+
+    void remove(uint32_t id)
+    {
+        Link &link = links[id];
+        at(link.prev).next = link.next;
+        at(link.next).prev = link.prev;
+        sizes[owner[id]]--;
+    }
+
+    // moves a node to the front of a list, possibly another one
+    void moveToFront(size_t list, uint32_t id)
+    {
+        remove(id);
+        pushFront(list, id);
+    }
+
+    // least recently pushed node of a list, NONE if the list is empty
+    uint32_t back(size_t list) const
+    {
+        return sizes[list] ? heads[list].prev : NONE;
+    }
+
+    size_t size(size_t list) const
+    {
+        return sizes[list];
+    }
+
+    // list a node is on
+    size_t listOf(uint32_t id) const
+    {
+        return owner[id];
+    }
+
+    // walks a list checking its links and size
+    bool check(size_t list)
+    {
+        size_t count = 0;
+        uint32_t head = HEAD + list;
+        for (uint32_t id = heads[list].next; id != head; id = links[id].next)
+        {
+            if (at(links[id].next).prev != id || owner[id] != list || ++count > sizes[list])
+            {
+                return false;
+            }
+        }
+        return count == sizes[list];
+    }
+};
+
+// Least recently used: reads move an entry to the front, the back is evicted.
+class LRUPolicy
+{
+protected:
+    NodeArena<Node> &nodes;
+    IdLists lists;
+
+public:
+    static constexpr size_t ENTRY_BYTES = 9; // links and owner
+
+    LRUPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &/*index*/) : nodes(nodes), lists(1) {}
+
+    void onInsert(Node *node)
+    {
+        lists.pushFront(0, node->id);
+    }
+
+    void onAccess(Node *node)
+    {
+        lists.moveToFront(0, node->id);
+    }
+
+    void onRemove(Node *node)
+    {
+        lists.remove(node->id);
+    }
+
+    Node *selectVictim()
+    {
+        uint32_t id = lists.back(0);
+        return id == IdLists::NONE ? nullptr : &nodes[id];
+    }
+
+    bool check(size_t entries)
+    {
+        return lists.check(0) && lists.size(0) == entries;
+    }
+};
+
+// First in first out: entries are evicted in insertion order, reads cost nothing.
+class FIFOPolicy : public LRUPolicy
+{
+public:
+    FIFOPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &index) : LRUPolicy(nodes, index) {}
+
+    void onAccess(Node */*node*/) {}
+};
+
+// W-TinyLFU: new entries go through a small LRU admission window, an entry leaving it joins the
+// main region(a segmented LRU) and has to prove itself at the next eviction: it stays only if a
+// frequency sketch has seen it more often than the main region's victim. One-off keys, like those
+// of a scan or a bulk import, churn through the window without displacing the frequently used
+// entries.
+//
+// The main region is split into probation, where entries from the window land, and protected,
+// where entries read again in probation are promoted. Protected entries beyond PROTECTED_PERCENT of
+// the main region are demoted back to probation. Victims are taken from the back of probation,
+// then of protected, then of the window.
+class WTinyLFUPolicy
+{
+    enum List
+    {
+        WINDOW,
+        PROBATION,
+        PROTECTED,
+        LIST_COUNT
+    };
+
+    NodeArena<Node> &nodes;
+    IdLists lists;
+    FrequencySketch sketch;
+    uint32_t candidate; // last entry to leave the window, not yet judged, NONE if none
+
+    size_t entries() const
+    {
+        return lists.size(WINDOW) + lists.size(PROBATION) + lists.size(PROTECTED);
+    }
+
+    uint32_t frequency(uint32_t id)
+    {
+        return sketch.frequency(nodes[id].key.hash());
+    }
+
+    // demotes protected entries beyond their share of the main region
+    void balanceProtected()
+    {
+        size_t main = lists.size(PROBATION) + lists.size(PROTECTED);
+        while (lists.size(PROTECTED) > main * PROTECTED_PERCENT / 100)
+        {
+            lists.moveToFront(PROBATION, lists.back(PROTECTED));
+        }
+    }
+
+public:
+    static constexpr size_t ENTRY_BYTES = 9 + 16;  // links and owner, at most two sketch words
+    static constexpr size_t WINDOW_PERCENT = 1;     // share of the entries in the admission window
+    static constexpr size_t PROTECTED_PERCENT = 80; // share of the main region that is protected
+
+    WTinyLFUPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &/*index*/) : nodes(nodes), lists(LIST_COUNT), candidate(IdLists::NONE) {}
+
+    void onInsert(Node *node)
+    {
+        sketch.ensureCapacity(entries() + 1);
+        sketch.increment(node->key.hash());
+        lists.pushFront(WINDOW, node->id);
+
+        // moving the window's oldest entries on to the main region
+        size_t window = entries() * WINDOW_PERCENT / 100;
+        while (lists.size(WINDOW) > (window > 0 ? window : 1))
+        {
+            candidate = lists.back(WINDOW);
+            lists.moveToFront(PROBATION, candidate);
+        }
+    }
+
+    void onAccess(Node *node)
+    {
+        sketch.increment(node->key.hash());
+        if (lists.listOf(node->id) == WINDOW)
+        {
+            lists.moveToFront(WINDOW, node->id);
+            return;
+        }
+
+        if (candidate == node->id)
+        {
+            candidate = IdLists::NONE;
+        }
+        lists.moveToFront(PROTECTED, node->id);
+        balanceProtected();
+    }
+
+    void onRemove(Node *node)
+    {
+        if (candidate == node->id)
+        {
+            candidate = IdLists::NONE;
+        }
+        lists.remove(node->id);
+    }
+
+    Node *selectVictim()
+    {
+        uint32_t victim = lists.back(PROBATION);
+        if (victim == IdLists::NONE || victim == candidate)
+        {
+            victim = lists.size(PROTECTED) ? lists.back(PROTECTED) : victim;
+        }
+
+        // the newest entry of the main region has to have been seen more often than the one it displaces
+        if (candidate != IdLists::NONE && candidate != victim)
+        {
+            uint32_t judged = candidate;
+            candidate = IdLists::NONE;
+            return &nodes[frequency(judged) > frequency(victim) ? victim : judged];
+        }
+
+        if (victim == IdLists::NONE)
+        {
+            victim = lists.back(WINDOW);
+        }
+        return victim == IdLists::NONE ? nullptr : &nodes[victim];
+    }
+
+    bool check(size_t entries)
+    {
+        for (size_t list = 0; list < LIST_COUNT; list++)
+        {
+            if (!lists.check(list))
+            {
+                return false;
+            }
+        }
+        return this->entries() == entries && (candidate == IdLists::NONE || lists.listOf(candidate) == PROBATION);
+    }
+};
+
+// ARC(Adaptive Replacement Cache): resident entries seen once sit in T1, entries read again in T2,
+// both LRU ordered. The keys of recently evicted entries are remembered(by hash) in the ghost
+// lists B1 and B2. A put of a key found in B1 means T1 was too small and grows its target share
+// p, one found in B2 shrinks it, so the balance between recency and frequency follows the traffic
+// without tuning. Victims come from T1 while it holds more than p entries, otherwise from T2.
+//
+// The cache's size is the number of resident entries c, the ghosts are kept to |T1| + |B1| <= c
+// and |T1| + |T2| + |B1| + |B2| <= 2c.
+class ARCPolicy
+{
+    enum List
+    {
+        T1,
+        T2
+    };
+
+    enum GhostList
+    {
+        B1,
+        B2
+    };
+
+    NodeArena<Node> &nodes;
+    IdLists lists;
+    IdLists ghosts; // ids index ghostHash
+    std::vector<uint64_t> ghostHash;
+    std::vector<uint32_t> freeGhosts;
+    std::unordered_map<uint64_t, uint32_t> ghostOf; // key hash to ghost id
+    size_t p;         // target size of T1
+    uint32_t newest;  // last entry inserted, never the victim while T2 has one
+    uint32_t evicted; // victim handed out by selectVictim, remembered as a ghost once removed
+
+    size_t residents() const
+    {
+        return lists.size(T1) + lists.size(T2);
+    }
+
+    void addGhost(size_t list, uint64_t hash)
+    {
+        auto it = ghostOf.find(hash);
+        if (it != ghostOf.end())
+        {
+            dropGhost(it->second);
+        }
+
+        uint32_t id;
+        if (!freeGhosts.empty())
+        {
+            id = freeGhosts.back();
+            freeGhosts.pop_back();
+        }
+        else
+        {
+            id = ghostHash.size();
+            ghostHash.push_back(0);
+        }
+        ghostHash[id] = hash;
+        ghosts.pushFront(list, id);
+        ghostOf[hash] = id;
+    }
+
+    void dropGhost(uint32_t id)
+    {
+        ghosts.remove(id);
+        ghostOf.erase(ghostHash[id]);
+        freeGhosts.push_back(id);
+    }
+
+    // forgets the oldest ghosts beyond the lists' bounds
+    void trimGhosts()
+    {
+        size_t c = residents();
+        while (ghosts.size(B1) && lists.size(T1) + ghosts.size(B1) > c)
+        {
+            dropGhost(ghosts.back(B1));
+        }
+        while (ghosts.size(B1) + ghosts.size(B2) && c + ghosts.size(B1) + ghosts.size(B2) > 2 * c)
+        {
+            dropGhost(ghosts.back(ghosts.size(B2) ? B2 : B1));
+        }
+    }
+
+public:
+    static constexpr size_t ENTRY_BYTES = 9 + 64; // links and owner, a ghost's links, hash and index entry
+
+    ARCPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &/*index*/)
+        : nodes(nodes), lists(2), ghosts(2), p(0), newest(IdLists::NONE), evicted(IdLists::NONE) {}
+
+    void onInsert(Node *node)
+    {
+        auto it = ghostOf.find(node->key.hash());
+        if (it == ghostOf.end())
+        {
+            lists.pushFront(T1, node->id);
+        }
+        else
+        {
+            // adapting p towards the list whose ghost was hit
+            size_t b1 = ghosts.size(B1), b2 = ghosts.size(B2);
+            if (ghosts.listOf(it->second) == B1)
+            {
+                size_t delta = b1 && b2 > b1 ? b2 / b1 : 1;
+                p = std::min(p + delta, residents() + 1);
+            }
+            else
+            {
+                size_t delta = b2 && b1 > b2 ? b1 / b2 : 1;
+                p = p > delta ? p - delta : 0;
+            }
+            dropGhost(it->second);
+            lists.pushFront(T2, node->id);
+        }
+
+        newest = node->id;
+        evicted = IdLists::NONE;
+        trimGhosts();
+    }
+
+    void onAccess(Node *node)
+    {
+        lists.moveToFront(T2, node->id);
+        evicted = IdLists::NONE;
+    }
+
+    void onRemove(Node *node)
+    {
+        size_t list = lists.listOf(node->id);
+        lists.remove(node->id);
+        if (node->id == newest)
+        {
+            newest = IdLists::NONE;
+        }
+
+        // deleted and expired keys leave no ghost, only the victim removed right after being selected does
+        bool wasEvicted = node->id == evicted;
+        evicted = IdLists::NONE;
+        if (wasEvicted)
+        {
+            addGhost(list == T1 ? B1 : B2, node->key.hash());
+        }
+        trimGhosts();
+    }
+
+    Node *selectVictim()
+    {
+        uint32_t t1 = lists.back(T1), t2 = lists.back(T2);
+        bool fromT1 = t1 != IdLists::NONE && (lists.size(T1) > p || t2 == IdLists::NONE);
+
+        // the newest entry is only selected when it is alone, the cache then keeps it
+        if (fromT1 ? t1 == newest && t2 != IdLists::NONE : t2 == newest && t1 != IdLists::NONE)
+        {
+            fromT1 = !fromT1;
+        }
+        uint32_t victim = fromT1 ? t1 : t2;
+        evicted = victim == newest ? IdLists::NONE : victim;
+        return victim == IdLists::NONE ? nullptr : &nodes[victim];
+    }
+
+    bool check(size_t entries)
+    {
+        return lists.check(T1) && lists.check(T2) && ghosts.check(B1) && ghosts.check(B2) && residents() == entries &&
+               ghostOf.size() == ghosts.size(B1) + ghosts.size(B2) && ghosts.size(B1) + ghosts.size(B2) <= entries;
+    }
+};
+
+// GreedyDual-Size-Frequency: every entry is scored L + frequency * costHint / size, size being the
+// bytes it is charged against the capacity. The lowest score is evicted and L, the cache's
+// inflation value, rises to it, so entries that aren't read again age out however valuable they
+// once were. Small, often read and expensive to recompute entries are kept first, maximizing hits
+// per byte of capacity.
+//
+// Scores are kept in a binary min-heap of ids with each id's position in the heap, an update is
+// O(log n).
+class GDSFPolicy
+{
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    NodeArena<Node> &nodes;
+    std::vector<uint32_t> heap;      // ids, lowest score first
+    std::vector<uint32_t> position;  // by id, index in heap
+    std::vector<double> score;       // by id
+    std::vector<uint32_t> frequency; // by id, puts and reads
+    double inflation;                // L, score of the last victim
+    uint32_t newest;                 // last entry inserted, never the victim while there are others
+    uint32_t evicted;                // victim handed out by selectVictim, raises L once removed
+
+    void rescore(Node *node)
+    {
+        double size = node->cost + node->value->cost;
+        score[node->id] = inflation + double(frequency[node->id]) * node->costHint / size;
+    }
+
+    void place(size_t i, uint32_t id)
+    {
+        heap[i] = id;
+        position[id] = i;
+    }
+
+    void siftUp(size_t i)
+    {
+        uint32_t id = heap[i];
+        while (i > 0 && score[heap[(i - 1) / 2]] > score[id])
+        {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, id);
+    }
+
+    void siftDown(size_t i)
+    {
+        uint32_t id = heap[i];
+        while (true)
+        {
+            size_t child = 2 * i + 1;
+            if (child >= heap.size())
+            {
+                break;
+            }
+            if (child + 1 < heap.size() && score[heap[child + 1]] < score[heap[child]])
+            {
+                child++;
+            }
+            if (score[heap[child]] >= score[id])
+            {
+                break;
+            }
+            place(i, heap[child]);
+            i = child;
+        }
+        place(i, id);
+    }
+
+public:
+    static constexpr size_t ENTRY_BYTES = 20; // heap slot, position, score and frequency
+
+    GDSFPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &/*index*/) : nodes(nodes), inflation(0), newest(NONE), evicted(NONE) {}
+
+    void onInsert(Node *node)
+    {
+        uint32_t id = node->id;
+        if (id >= position.size())
+        {
+            position.resize(id + 1);
+            score.resize(id + 1);
+            frequency.resize(id + 1);
+        }
+
+        frequency[id] = 1;
+        rescore(node);
+        heap.push_back(id);
+        siftUp(heap.size() - 1);
+        newest = id;
+        evicted = NONE;
+    }
+
+    void onAccess(Node *node)
+    {
+        evicted = NONE;
+        frequency[node->id]++;
+        rescore(node);
+
+        // the score only grows
+        siftDown(position[node->id]);
+    }
+
+    void onRemove(Node *node)
+    {
+        size_t i = position[node->id];
+        uint32_t last = heap.back();
+        heap.pop_back();
+        if (last != node->id)
+        {
+            place(i, last);
+            siftUp(i);
+            siftDown(position[last]);
+        }
+        if (node->id == newest)
+        {
+            newest = NONE;
+        }
+
+        // L only rises to the score of an entry actually evicted
+        if (node->id == evicted)
+        {
+            inflation = std::max(inflation, score[node->id]);
+        }
+        evicted = NONE;
+    }
+
+    Node *selectVictim()
+    {
+        if (heap.empty())
+        {
+            return nullptr;
+        }
+
+        // the second lowest score is one of the root's children
+        size_t i = 0;
+        if (heap[0] == newest && heap.size() > 1)
+        {
+            i = heap.size() > 2 && score[heap[2]] < score[heap[1]] ? 2 : 1;
+        }
+
+        // a lone newest entry is kept by the cache, selecting it evicts nothing
+        evicted = heap[i] == newest ? NONE : heap[i];
+        return &nodes[heap[i]];
+    }
+
+    bool check(size_t entries)
+    {
+        for (size_t i = 0; i < heap.size(); i++)
+        {
+            if (position[heap[i]] != i || (i > 0 && score[heap[(i - 1) / 2]] > score[heap[i]]))
+            {
+                return false;
+            }
+        }
+        return heap.size() == entries;
+    }
+};
+
+// Approximate LRU by sampling, as Redis does: entries keep no links, only a 24-bit stamp of their
+// last access in the node. To choose a victim SAMPLES random entries of the key index join a pool
+// of the POOL_SIZE least recently used entries seen so far, and the least recently used entry of
+// the pool is evicted. More samples make it closer to an exact LRU. Reads only write the stamp.
+//
+// The clock ticks once every 1/256th of the entries' worth of accesses, so stamps only wrap around
+// after 65536 times the cache's entries in accesses.
+template <size_t SAMPLES = 5>
+class SampledLRUPolicy
+{
+    static constexpr uint32_t STAMP_MASK = (1 << 24) - 1;
+    static constexpr size_t POOL_SIZE = 16;
+
+    NodeArena<Node> &nodes;
+    const HashIndex<Node> &index;
+    std::minstd_rand rng;
+    size_t entries;
+    uint32_t clock;
+    size_t ticks;    // accesses since the clock last moved
+    uint32_t newest; // last entry inserted, never the victim while there are others
+    std::vector<uint32_t> pool; // eviction candidates, ids
+
+    void stamp(Node *node)
+    {
+        if (++ticks >= std::max<size_t>(entries / 256, 1))
+        {
+            clock = (clock + 1) & STAMP_MASK;
+            ticks = 0;
+        }
+        node->stamp = clock;
+    }
+
+    uint32_t age(const Node *node) const
+    {
+        return (clock - node->stamp) & STAMP_MASK;
+    }
+
+    // first entry other than the newest at or after a random slot
+    Node *sample()
+    {
+        size_t slots = index.capacity();
+        size_t slot = std::uniform_int_distribution<size_t>(0, slots - 1)(rng);
+        for (size_t i = 0; i < slots; i++, slot = slot + 1 < slots ? slot + 1 : 0)
+        {
+            Node *node = index.at(slot);
+            if (node && node->id != newest)
+            {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    static constexpr size_t ENTRY_BYTES = 0; // the stamp fits in the node's padding
+
+    SampledLRUPolicy(NodeArena<Node> &nodes, const HashIndex<Node> &index)
+        : nodes(nodes), index(index), entries(0), clock(0), ticks(0), newest(UINT32_MAX) {}
+
+    void onInsert(Node *node)
+    {
+        entries++;
+        newest = node->id;
+        stamp(node);
+    }
+
+    void onAccess(Node *node)
+    {
+        stamp(node);
+    }
+
+    void onRemove(Node *node)
+    {
+        entries--;
+        if (node->id == newest)
+        {
+            newest = UINT32_MAX;
+        }
+
+        auto it = std::find(pool.begin(), pool.end(), node->id);
+        if (it != pool.end())
+        {
+            *it = pool.back();
+            pool.pop_back();
+        }
+    }
+
+    Node *selectVictim()
+    {
+        if (entries == 0)
+        {
+            return nullptr;
+        }
+        if (entries == 1 && newest != UINT32_MAX)
+        {
+            return &nodes[newest];
+        }
+
+        for (size_t i = 0; i < SAMPLES; i++)
+        {
+            uint32_t id = sample()->id;
+            if (std::find(pool.begin(), pool.end(), id) == pool.end())
+            {
+                pool.push_back(id);
+            }
+        }
+
+        // the pool's ages may have changed since they were sampled, ordering them now
+        std::sort(pool.begin(), pool.end(), [this](uint32_t a, uint32_t b)
+                  { return age(&nodes[a]) > age(&nodes[b]); });
+        if (pool.size() > POOL_SIZE)
+        {
+            pool.resize(POOL_SIZE);
+        }
+
+        return &nodes[pool[0]];
+    }
+
+    bool check(size_t entries)
+    {
+        return this->entries == entries && pool.size() <= POOL_SIZE;
+    }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+// Approximate access counts of keys: a count-min sketch of 4-bit counters.
+//
+// A key's hash picks DEPTH counters of the table, its frequency is the smallest of them so
+// collisions only ever overestimate it. Counters saturate at 15. Every time the number of
+// increments reaches SAMPLE_FACTOR times the number of keys the table is sized for(one word of 16
+// counters per key), all counters are halved so that old accesses fade and the sketch follows the
+// current popularity of keys.
+//
+// The table grows with the number of keys it has to tell apart. Counters are picked by the low bits
+// of a hash, so doubling the table copies it into its upper half and keeps every estimate.
+// Not thread safe, callers are expected to hold their own lock.
+class FrequencySketch
+{
+public:
+    static constexpr int DEPTH = 4;
+    static constexpr size_t SAMPLE_FACTOR = 10;
+
+private:
+    static constexpr size_t COUNTERS_PER_WORD = 16;
+    static constexpr size_t MIN_WORDS = 16;
+
+    std::vector<uint64_t> table; // 16 counters of 4 bits per word
+    size_t counterMask;
+    size_t additions; // increments since the last halving
+
+    // index of the i-th counter of a key
+    size_t counterFor(uint64_t hash, int i) const
+    {
+        // double hashing, the odd step keeps the counters of a key apart
+        uint64_t step = (hash >> 32) | 1;
+        uint64_t h = (hash + i * step) * 0x9E3779B97F4A7C15ULL;
+        return (h >> 20) & counterMask;
+    }
+
+    uint32_t counter(size_t index) const
+    {
+        return (table[index / COUNTERS_PER_WORD] >> (index % COUNTERS_PER_WORD * 4)) & 0xF;
+    }
+
+    // halves every counter
+    void age()
+    {
+        for (uint64_t &word : table)
+        {
+            word = (word >> 1) & 0x7777777777777777ULL;
+        }
+        additions /= 2;
+    }
+
+public:
+    FrequencySketch() : table(MIN_WORDS, 0), counterMask(MIN_WORDS * COUNTERS_PER_WORD - 1), additions(0) {}
+
+    // makes room for telling `keys` keys apart
+    void ensureCapacity(size_t keys)
+    {
+        while (table.size() < keys)
+        {
+            size_t words = table.size();
+            table.resize(2 * words);
+            std::copy(table.begin(), table.begin() + words, table.begin() + words);
+            counterMask = table.size() * COUNTERS_PER_WORD - 1;
+        }
+    }
+
+    uint32_t frequency(uint64_t hash) const
+    {
+        uint32_t freq = 15;
+        for (int i = 0; i < DEPTH; i++)
+        {
+            uint32_t c = counter(counterFor(hash, i));
+            freq = c < freq ? c : freq;
+        }
+        return freq;
+    }
+
+    void increment(uint64_t hash)
+    {
+        bool added = false;
+        for (int i = 0; i < DEPTH; i++)
+        {
+            size_t index = counterFor(hash, i);
+            if (counter(index) < 15)
+            {
+                table[index / COUNTERS_PER_WORD] += 1ULL << (index % COUNTERS_PER_WORD * 4);
+                added = true;
+            }
+        }
+
+        if (added && ++additions >= SAMPLE_FACTOR * table.size())
+        {
+            age();
+        }
+    }
+
+    // bytes held by the table
+    size_t bytes() const
+    {
+        return table.size() * sizeof(uint64_t);
+    }
+};
+
+#endif
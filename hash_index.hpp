@@ -0,0 +1,226 @@
+#ifndef HASH_INDEX_HPP
+#define HASH_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "inline_key.hpp"
+
+// Intrusive open addressing hash index, Swiss table style.
+//
+// Slots hold pointers straight to the entries, T must expose `InlineKey key`. Every slot has a
+// control byte: EMPTY, DELETED or the low 7 bits of the key's hash(H2). Control bytes are probed
+// a group of 16 at a time with SSE2, so a lookup reads one control group and then, usually, only
+// the matching entry. Groups are probed triangularly starting at the group picked by the hash's
+// high bits(H1).
+//
+// Not thread safe, callers are expected to hold their own lock.
+template <class T>
+class HashIndex
+{
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+    static constexpr size_t GROUP = 16;
+    static constexpr size_t MIN_CAPACITY = 64;
+
+    std::vector<int8_t> ctrl;
+    std::vector<T *> slots;
+    size_t count;
+    size_t tombstones;
+    size_t mask; // number of groups - 1
+
+    static int8_t h2(uint64_t hash)
+    {
+        return hash & 0x7F;
+    }
+
+    static size_t h1(uint64_t hash)
+    {
+        return hash >> 7;
+    }
+
+    // bitmask of the slots in a group whose control byte equals value
+    static uint32_t match(const int8_t *group, int8_t value)
+    {
+#ifdef __SSE2__
+        __m128i ctrlBytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrlBytes, _mm_set1_epi8(value)));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < GROUP; i++)
+        {
+            bits |= uint32_t(group[i] == value) << i;
+        }
+        return bits;
+#endif
+    }
+
+    // bitmask of the slots in a group which are EMPTY or DELETED(both have the sign bit set)
+    static uint32_t matchFree(const int8_t *group)
+    {
+#ifdef __SSE2__
+        __m128i ctrlBytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return _mm_movemask_epi8(ctrlBytes);
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < GROUP; i++)
+        {
+            bits |= uint32_t(group[i] < 0) << i;
+        }
+        return bits;
+#endif
+    }
+
+    static int lowestBit(uint32_t bits)
+    {
+        return __builtin_ctz(bits);
+    }
+
+    // slot holding the key, SIZE_MAX if the key is not in the index
+    size_t findSlot(const InlineKey &key, uint64_t hash) const
+    {
+        size_t group = h1(hash) & mask;
+        for (size_t step = 1;; step++)
+        {
+            const int8_t *g = &ctrl[group * GROUP];
+            for (uint32_t bits = match(g, h2(hash)); bits; bits &= bits - 1)
+            {
+                size_t slot = group * GROUP + lowestBit(bits);
+                if (slots[slot]->key == key)
+                {
+                    return slot;
+                }
+            }
+
+            // an EMPTY slot ends every probe sequence that reaches this group
+            if (match(g, EMPTY))
+            {
+                return SIZE_MAX;
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    void insertUnique(T *node, uint64_t hash)
+    {
+        size_t group = h1(hash) & mask;
+        for (size_t step = 1;; step++)
+        {
+            uint32_t bits = matchFree(&ctrl[group * GROUP]);
+            if (bits)
+            {
+                size_t slot = group * GROUP + lowestBit(bits);
+                if (ctrl[slot] == DELETED)
+                {
+                    tombstones--;
+                }
+                ctrl[slot] = h2(hash);
+                slots[slot] = node;
+                count++;
+                return;
+            }
+            group = (group + step) & mask;
+        }
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<int8_t> oldCtrl(capacity, EMPTY);
+        std::vector<T *> oldSlots(capacity, nullptr);
+        oldCtrl.swap(ctrl);
+        oldSlots.swap(slots);
+
+        mask = capacity / GROUP - 1;
+        count = 0;
+        tombstones = 0;
+
+        for (size_t i = 0; i < oldSlots.size(); i++)
+        {
+            if (oldCtrl[i] >= 0)
+            {
+                insertUnique(oldSlots[i], oldSlots[i]->key.hash());
+            }
+        }
+    }
+
+public:
+    HashIndex() : count(0), tombstones(0)
+    {
+        ctrl.assign(MIN_CAPACITY, EMPTY);
+        slots.assign(MIN_CAPACITY, nullptr);
+        mask = MIN_CAPACITY / GROUP - 1;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    size_t capacity() const
+    {
+        return slots.size();
+    }
+
+    // entry in a slot, nullptr for an empty slot. Slots are numbered from 0 to capacity() - 1.
+    T *at(size_t slot) const
+    {
+        return ctrl[slot] >= 0 ? slots[slot] : nullptr;
+    }
+
+    T *find(const InlineKey &key) const
+    {
+        size_t slot = findSlot(key, key.hash());
+        return slot == SIZE_MAX ? nullptr : slots[slot];
+    }
+
+    // inserts a node whose key is not in the index yet
+    void insert(T *node)
+    {
+        // keeping the load(entries and tombstones) under 7/8
+        if ((count + tombstones + 1) * 8 > capacity() * 7)
+        {
+            rehash(count * 2 * 8 > capacity() * 7 ? capacity() * 2 : capacity());
+        }
+        insertUnique(node, node->key.hash());
+    }
+
+    void erase(T *node)
+    {
+        size_t slot = findSlot(node->key, node->key.hash());
+        if (slot == SIZE_MAX)
+        {
+            return;
+        }
+
+        // a group with an EMPTY slot never made a probe move on, the slot can become EMPTY again
+        size_t group = slot / GROUP;
+        if (match(&ctrl[group * GROUP], EMPTY))
+        {
+            ctrl[slot] = EMPTY;
+        }
+        else
+        {
+            ctrl[slot] = DELETED;
+            tombstones++;
+        }
+        slots[slot] = nullptr;
+        count--;
+    }
+
+    template <class F>
+    void forEach(F f) const
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (ctrl[i] >= 0)
+            {
+                f(slots[i]);
+            }
+        }
+    }
+};
+
+#endif
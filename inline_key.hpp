@@ -0,0 +1,90 @@
+#ifndef INLINE_KEY_HPP
+#define INLINE_KEY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Fixed width key stored inline, keys are at most MAX_LEN(32) bytes long.
+// Unused bytes are kept zeroed so that two keys compare with two 16-byte loads.
+class InlineKey
+{
+public:
+    static constexpr size_t MAX_LEN = 32;
+
+private:
+    alignas(16) char bytes[MAX_LEN];
+    uint8_t len;
+
+public:
+    InlineKey() : len(0)
+    {
+        memset(bytes, 0, MAX_LEN);
+    }
+
+    // key must be at most MAX_LEN bytes long
+    explicit InlineKey(std::string_view key) : len(key.size())
+    {
+        memset(bytes, 0, MAX_LEN);
+        memcpy(bytes, key.data(), key.size());
+    }
+
+    size_t size() const
+    {
+        return len;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(bytes, len);
+    }
+
+    std::string str() const
+    {
+        return std::string(bytes, len);
+    }
+
+    bool operator==(const InlineKey &other) const
+    {
+        if (len != other.len)
+        {
+            return false;
+        }
+#ifdef __SSE2__
+        __m128i lo = _mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(bytes)),
+                                    _mm_load_si128(reinterpret_cast<const __m128i *>(other.bytes)));
+        __m128i hi = _mm_cmpeq_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(bytes + 16)),
+                                    _mm_load_si128(reinterpret_cast<const __m128i *>(other.bytes + 16)));
+        return _mm_movemask_epi8(_mm_and_si128(lo, hi)) == 0xFFFF;
+#else
+        return memcmp(bytes, other.bytes, MAX_LEN) == 0;
+#endif
+    }
+
+    bool operator!=(const InlineKey &other) const
+    {
+        return !(*this == other);
+    }
+
+    // 64-bit hash over the four 8-byte words of the key
+    uint64_t hash() const
+    {
+        uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+        for (size_t i = 0; i < MAX_LEN; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            h = (h ^ word) * 0xBF58476D1CE4E5B9ULL;
+            h ^= h >> 31;
+        }
+        h *= 0x94D049BB133111EBULL;
+        return h ^ (h >> 32);
+    }
+};
+
+#endif
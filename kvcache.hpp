@@ -2,35 +2,38 @@
 #define DLL_HPP
 
 #include <string>
-#include <unordered_map>
-#include <queue>
 #include "json.hpp"
+#include "timing_wheel.hpp"
+#include "page_source.hpp"
+#include "slab.hpp"
+#include "inline_key.hpp"
+#include "hash_index.hpp"
+#include "node_arena.hpp"
+#include "value_pool.hpp"
+#include "lz_codec.hpp"
+#include "memory_monitor.hpp"
+#include "miss_ratio_curve.hpp"
+#include "node.hpp"
+#include "eviction_policy.hpp"
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
 #include <fcntl.h>
 #include <iostream>
 
 using nlohmann::json;
 
-// Double Linked List Node definition
-class Node
-{
-public:
-    std::string key;
-    json data;
-    int expiry;
-    Node *next;
-    Node *prev;
-
-    Node(std::string key, json data, int expiry = -1, Node *prev = nullptr, Node *next = nullptr);
-};
-
 // Key-Value-Expiry object
 struct KVE
 {
     std::string key;
     json data;
-    int expiry = -1;
+    int expiry = -1;        // TTL in seconds
+    long long expiryMs = -1; // TTL in milliseconds, takes precedence over expiry when set
+    uint32_t costHint = 1;   // how expensive the value is to recompute, see Node::costHint
 };
 
 enum Error_code
@@ -51,46 +54,247 @@ struct Error_obj
     std::string value;
 };
 
+// Outcome of a call, nothing is allocated on success
+struct Status
+{
+    bool ok = true;
+    Error_code code = UNKNOWN_ERROR; // only meaningful when the call failed
+    std::string detail;              // error message, empty on success
+
+    explicit operator bool() const
+    {
+        return ok;
+    }
+};
+
+// Memory taken by the cache
+struct MemoryStats
+{
+    long long used;    // bytes charged against the capacity for the entries
+    size_t resident;   // bytes of slab pages and node arena chunks held from the system
+    size_t emptyPages; // bytes in empty slab pages, reusable by values of any size
+};
+
+// How values are serialized in the cache
+enum ValueEncoding
+{
+    TEXT,    // the validated JSON text as given
+    MSGPACK, // MessagePack
+    CBOR     // CBOR
+};
+
+// Tunables of the cache
+struct KVconfig
+{
+    ValueEncoding valueEncoding = TEXT;
+
+    // bytes the entries may take, can be changed later with setCapacity
+    long long capacity = 1024LL * 1024 * 1024;
+
+    // follows the memory of the cgroup(v2) the cache runs in: the capacity shrinks while the cgroup
+    // is short of its headroom or stalls on memory(PSI), and grows back up to `capacity` once
+    // memory frees up
+    bool followMemoryPressure = false;
+    std::string cgroupPath = "";              // cgroup directory, empty for the process's own cgroup
+    int memoryCheckIntervalMs = 1000;         // interval between two reads of the cgroup's memory
+    int memoryHeadroomPercent = 10;           // share of the cgroup's limit kept free
+    double memoryPressureLimit = 10;          // PSI "some avg10" in percent above which the capacity shrinks
+    long long minCapacity = 16 * 1024 * 1024; // the capacity never shrinks below this
+
+    // expiry work is split into slices, the lock is released between two slices
+    int reapSliceKeys = 128;   // max expired entries removed per slice
+    int reapSliceMicros = 500; // max time spent per slice in microseconds, 0 for no time budget
+    int reapIntervalMs = 100;  // interval between two reaper passes in milliseconds
+
+    // stores identical values once, shared by all the keys holding them
+    bool dedupValues = false;
+
+    // values at least this many bytes long(once encoded) are compressed, 0 disables compression
+    size_t compressAbove = 0;
+
+    // backs the nodes and the values with 2 MiB pages(MAP_HUGETLB, falling back to MADV_HUGEPAGE)
+    bool hugePages = false;
+
+    // moves values out of sparsely used slab pages so that the pages can be reused by any size class
+    bool defragment = false;
+    int defragIntervalMs = 1000; // interval between two defragmentation passes
+    int defragSliceValues = 256; // values of the drained page tried per slice
+
+    // TTLs are extended by a random amount in [0, ttl * ttlJitterPercent / 100 + ttlJitterMs]
+    // so that keys created together don't all expire together
+    int ttlJitterPercent = 0;
+    long long ttlJitterMs = 0;
+
+    // share of keys whose reads are sampled to estimate the hit ratio at other capacities(see
+    // estimateHitRatio), 0 disables the estimate. 0.01 is usually accurate to a few percent.
+    double mrcSampleRate = 0;
+};
+
 // callback function type declaration
 typedef void (*Callback)(std::vector<Error_obj> err);
 
-class KVcache
+template <class EvictionPolicy>
+class BasicKVcache;
+
+// Read-only view of a value pinned in the cache. Reading it copies nothing, the bytes stay valid
+// until the view is destroyed even if the key is deleted or evicted meanwhile.
+// A view must not outlive its cache.
+class ValueView
+{
+    template <class>
+    friend class BasicKVcache;
+
+    ValueEncoding encoding;
+    ValueBlob *blob;       // pinned blob, nullptr for a missing key
+    std::string unpacked;  // decompressed bytes of a compressed blob
+
+    // takes over the caller's pin on the blob, dropped even if decompressing throws
+    ValueView(ValueEncoding encoding, ValueBlob *blob);
+
+public:
+    ValueView();
+    ValueView(ValueView &&other) noexcept;
+    ValueView &operator=(ValueView &&other) noexcept;
+    ValueView(const ValueView &) = delete;
+    ValueView &operator=(const ValueView &) = delete;
+    ~ValueView();
+
+    // false for a missing key
+    explicit operator bool() const;
+
+    // the value's encoded bytes(see ValueEncoding)
+    std::string_view bytes() const;
+    // the value as json, {} for a missing key
+    json value() const;
+    // the value's JSON text, {} for a missing key
+    std::string text() const;
+};
+
+// The cache, evicting entries as chosen by EvictionPolicy(see eviction_policy.hpp) once they
+// outgrow the capacity
+template <class EvictionPolicy>
+class BasicKVcache
 {
     // -----------------------critical Section-----------------
-    int capacity, size;
-    Node *head;
-    Node *tail;
-    std::unordered_map<std::string, Node *> cache;
-    std::priority_queue<std::pair<int, std::string>, std::vector<std::pair<int, std::string>>, std::greater<std::pair<int, std::string>>> pq;
+    long long capacity, size;
+    long long capacityTarget; // capacity being shrunk to, capacity follows it down as entries are evicted
+    PageSource pages;         // backs the node arena and the slab
+    NodeArena<Node> nodes;
+    // slots point straight at the nodes and are keyed by the node's own inline key
+    HashIndex<Node> cache;
+    EvictionPolicy policy;
+    TimingWheel<Node> ttl;
+    SlabAllocator slab; // backs the values
+    ValuePool values;
+    MemoryMonitor memory;
+    MissRatioCurve mrc; // reuse distances of sampled keys, see KVconfig::mrcSampleRate
     std::string file;
+    KVconfig config;
+    std::minstd_rand rng;
 
     // locks, mutexes and condition variables
     std::mutex m;
     std::condition_variable cv;
     int fd;
     flock lock;
+
+    // background thread reaping expired entries
+    std::thread reaper;
+    std::atomic<bool> stopping;
     // -------------------------------------------------------
 
-    void removeNode(Node *node);
-    void insertAfterStart(Node *node);
-    void clearExpired();
+    // monotonic time in ms, refreshed every CLOCK_TICK_MS so the hot path never reads the clock. The
+    // ticker thread refreshing it never takes the lock, so the clock keeps moving while a long
+    // operation holds it.
+    std::atomic<long long> clockMs;
+    std::thread ticker;
+
+    // number of entries expired between two checks of the slice's time budget
+    static constexpr int REAP_CHUNK = 16;
+    // resolution of the cached clock in milliseconds
+    static constexpr int CLOCK_TICK_MS = 1;
+
+    Node *findNode(std::string_view key);
+    Node *insertEntry(std::string_view key, std::string_view bytes, long long expiry, uint32_t costHint = 1);
+    Status putEntry(std::string_view key, std::string_view value, const json *data, std::chrono::milliseconds expiry, uint32_t costHint);
+    static void report(const Status &status, std::string_view key, std::string_view value, Callback callback);
+    void eraseNode(Node *node);
+    void expireNode(Node *node);
+    uint32_t entryCost();
+    bool checkInvariants();
+    void debugValidate();
+    std::string_view encodeValue(std::string_view value, std::string &encoded);
+    std::string encodeValue(const json &data);
+    static std::string unpack(const char *bytes, size_t len, size_t rawLen);
+    bool isExpired(Node *node);
+    long long deadlineFor(long long ttlMs);
+    long long nowMs();
+    static long long readClock();
+    static long long wallClockMs();
+    int reapSlice();
+    int shrinkSlice();
+    bool defragSlice(const std::vector<void *> &chunks, size_t &next);
+    void defragPass();
+    void resize(std::unique_lock<std::mutex> &ul);
+    void followMemory();
+    void reaperLoop();
+    void tickerLoop();
     void exportFile();
     void importFile(json &j);
     static void defaultCallbackHandler(std::vector<Error_obj> err)
     {
-        for (int i = 0; i < err.size(); i++)
+        for (size_t i = 0; i < err.size(); i++)
         {
             std::cout << err[i].code << " " << err[i].errmsg << " " << err[i].key << " " << err[i].value << std::endl;
         }
     }
 
 public:
-    KVcache(std::string name = "./data-store.json");
-    ~KVcache();
-    json getKey(std::string key);
-    void putKey(std::string key, std::string value, int expiry = -1, Callback callback = defaultCallbackHandler);
-    void deleteKey(std::string key, Callback callback = defaultCallbackHandler);
+    BasicKVcache(std::string name = "./data-store.json", KVconfig config = KVconfig());
+    ~BasicKVcache();
+    json getKey(std::string_view key);
+    std::string getKeyText(std::string_view key);
+    // pins the value instead of copying it, see ValueView
+    ValueView getKeyView(std::string_view key);
+    void putKey(std::string_view key, std::string_view value, int expiry = -1, Callback callback = defaultCallbackHandler);
+    // costHint tells size aware eviction policies how expensive the value is to recompute
+    void putKey(std::string_view key, std::string_view value, std::chrono::milliseconds expiry, Callback callback = defaultCallbackHandler, uint32_t costHint = 1);
+    // stores a prebuilt value without going through its text
+    void putJson(std::string_view key, const json &value, std::chrono::milliseconds expiry = std::chrono::milliseconds(-1), Callback callback = defaultCallbackHandler, uint32_t costHint = 1);
+    void deleteKey(std::string_view key, Callback callback = defaultCallbackHandler);
+
+    // same as putKey, putJson and deleteKey, returning the outcome instead of calling back
+    Status tryPutKey(std::string_view key, std::string_view value, std::chrono::milliseconds expiry = std::chrono::milliseconds(-1), uint32_t costHint = 1);
+    Status tryPutJson(std::string_view key, const json &value, std::chrono::milliseconds expiry = std::chrono::milliseconds(-1), uint32_t costHint = 1);
+    Status tryDeleteKey(std::string_view key);
     void batchCreate(int n, KVE val[], Callback callback = defaultCallbackHandler);
+
+    // changes the capacity, entries are evicted in slices until they fit
+    void setCapacity(long long bytes);
+    long long getCapacity();
+
+    // memory used by the entries and held from the system
+    MemoryStats memoryStats();
+
+    // hit ratio the reads so far would have had in an LRU cache of `bytes` capacity, estimated from
+    // the keys sampled at KVconfig::mrcSampleRate, 0 while sampling is off
+    double estimateHitRatio(long long bytes);
+
+    // checks the cache's bookkeeping(sizes, eviction policy, index, timers), returns false on a violation
+    bool validate();
 };
 
+#include "kvcache.tpp"
+
+// the bundled policies are instantiated once in kvcache.cpp, other policies are instantiated where
+// they are used
+extern template class BasicKVcache<LRUPolicy>;
+extern template class BasicKVcache<FIFOPolicy>;
+extern template class BasicKVcache<WTinyLFUPolicy>;
+extern template class BasicKVcache<ARCPolicy>;
+extern template class BasicKVcache<GDSFPolicy>;
+extern template class BasicKVcache<SampledLRUPolicy<>>;
+
+using KVcache = BasicKVcache<LRUPolicy>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,1085 @@
+#ifndef KVCACHE_TPP
+#define KVCACHE_TPP
+
+// member definitions of BasicKVcache, included at the end of kvcache.hpp so that any policy
+// can be instantiated, kvcache.cpp instantiates the bundled ones once
+
+#include <string>
+#include <ctime>
+#include "json.hpp"
+#include <iostream>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+
+// builds the json of a value stored with the given encoding
+inline json decodeValue(ValueEncoding encoding, const char *bytes, size_t len)
+{
+    switch (encoding)
+    {
+    case MSGPACK:
+        return json::from_msgpack(bytes, bytes + len);
+    case CBOR:
+        return json::from_cbor(bytes, bytes + len);
+    default:
+        return json::parse(bytes, bytes + len);
+    }
+}
+
+// JSON text of an encoded value, TEXT values are returned as stored
+inline std::string decodeText(ValueEncoding encoding, const char *bytes, size_t len)
+{
+    if (encoding == TEXT)
+    {
+        return std::string(bytes, len);
+    }
+    return decodeValue(encoding, bytes, len).dump();
+}
+
+template <class EvictionPolicy>
+BasicKVcache<EvictionPolicy>::BasicKVcache(std::string name, KVconfig config) : pages(config.hugePages), nodes(pages), policy(nodes, cache), ttl(readClock()), slab(pages), values(slab, config.dedupValues), memory(config.cgroupPath), mrc(config.mrcSampleRate), clockMs(readClock())
+{
+    file = name;
+    this->config = config;
+    rng.seed(std::random_device()());
+
+    size = 0;
+    capacity = capacityTarget = config.capacity;
+    stopping = false;
+
+    json j;
+    {
+        try
+        {
+            // reading from the file and converting to json
+            std::ifstream initFile(name);
+            std::string content;
+            getline(initFile, content);
+            j = content.empty() ? json::object() : json::parse(content);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "error while importing : " << e.what() << std::endl;
+        }
+    }
+
+    // file locking for process exclusion
+    fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+
+    if (fd < 0)
+    {
+        throw "File cannot be opened or already in use!!";
+    }
+
+    fcntl(fd, F_SETLKW, &lock);
+
+    // importing from the file after locking it
+    importFile(j);
+    exportFile();
+
+    // starting the threads only after the cache is fully initialized
+    ticker = std::thread(&BasicKVcache::tickerLoop, this);
+    reaper = std::thread(&BasicKVcache::reaperLoop, this);
+};
+
+// destructor
+template <class EvictionPolicy>
+BasicKVcache<EvictionPolicy>::~BasicKVcache()
+{
+    // stopping the threads before tearing down the cache, the reaper may be waiting on cv
+    {
+        std::unique_lock ul(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (reaper.joinable())
+    {
+        reaper.join();
+    }
+    if (ticker.joinable())
+    {
+        ticker.join();
+    }
+}
+template <class EvictionPolicy>
+json BasicKVcache<EvictionPolicy>::getKey(std::string_view key)
+{
+    return getKeyView(key).value();
+}
+
+// returns the JSON text of a key's value, without building a json object when stored as TEXT
+template <class EvictionPolicy>
+std::string BasicKVcache<EvictionPolicy>::getKeyText(std::string_view key)
+{
+    return getKeyView(key).text();
+}
+
+template <class EvictionPolicy>
+ValueView BasicKVcache<EvictionPolicy>::getKeyView(std::string_view key)
+{
+    // acquiring lock for the mutex
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    Node *node = findNode(key);
+
+    // sampling the read for the hit ratio estimate, hit or miss
+    if (mrc.enabled() && key.size() <= InlineKey::MAX_LEN)
+    {
+        mrc.reference(node ? node->key.hash() : InlineKey(key).hash());
+    }
+
+    // returning early if key does not exist
+    if (!node)
+    {
+        ul.unlock();
+        cv.notify_one();
+        return ValueView();
+    }
+
+    policy.onAccess(node);
+
+    // pinning the value, the node may be evicted as soon as the lock is released
+    ValueBlob *blob = node->value;
+    ValuePool::pin(blob);
+
+    // releasing the lock and notifying other threads
+    ul.unlock();
+    cv.notify_one();
+
+    // decompressing, if needed, outside the lock
+    return ValueView(config.valueEncoding, blob);
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::putKey(std::string_view key, std::string_view value, int expiry, Callback callback)
+{
+    putKey(key, value, std::chrono::milliseconds(expiry == -1 ? -1 : expiry * 1000LL), callback);
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::putKey(std::string_view key, std::string_view value, std::chrono::milliseconds expiry, Callback callback, uint32_t costHint)
+{
+    report(tryPutKey(key, value, expiry, costHint), key, value, callback);
+}
+
+// stores a prebuilt value, skipping the parse(and for TEXT the validation) of its text
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::putJson(std::string_view key, const json &value, std::chrono::milliseconds expiry, Callback callback, uint32_t costHint)
+{
+    std::string text = value.dump();
+    report(putEntry(key, text, &value, expiry, costHint), key, text, callback);
+}
+
+template <class EvictionPolicy>
+Status BasicKVcache<EvictionPolicy>::tryPutKey(std::string_view key, std::string_view value, std::chrono::milliseconds expiry, uint32_t costHint)
+{
+    return putEntry(key, value, nullptr, expiry, costHint);
+}
+
+template <class EvictionPolicy>
+Status BasicKVcache<EvictionPolicy>::tryPutJson(std::string_view key, const json &value, std::chrono::milliseconds expiry, uint32_t costHint)
+{
+    std::string text = value.dump();
+    return putEntry(key, text, &value, expiry, costHint);
+}
+
+// shared by the put calls: value is the JSON text, data the prebuilt value if there is one
+template <class EvictionPolicy>
+Status BasicKVcache<EvictionPolicy>::putEntry(std::string_view key, std::string_view value, const json *data, std::chrono::milliseconds expiry, uint32_t costHint)
+{
+    // validating key and value lengths
+    if (key.size() > InlineKey::MAX_LEN)
+    {
+        return {false, Error_code::KEY_TOO_LONG, "key too long"};
+    }
+
+    if (value.size() > 16 * 1024)
+    {
+        return {false, Error_code::VALUE_TOO_LONG, "Value too long"};
+    }
+
+    // acquiring lock for the mutex
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    Status status;
+    try
+    {
+        // checking if the key already exists in the cache
+        if (!findNode(key))
+        {
+            std::string encoded;
+            std::string_view bytes;
+            if (!data)
+            {
+                bytes = encodeValue(value, encoded);
+            }
+            else if (config.valueEncoding == TEXT)
+            {
+                bytes = value;
+            }
+            else
+            {
+                bytes = encoded = encodeValue(*data);
+            }
+
+            insertEntry(key, bytes, deadlineFor(expiry.count()), costHint);
+            exportFile();
+        }
+        else
+        {
+            status = {false, Error_code::KEY_ALREADY_EXISTS, "key already exists"};
+        }
+    }
+    catch (const std::exception &e)
+    {
+        status = {false, Error_code::UNKNOWN_ERROR, e.what()};
+    }
+
+    debugValidate();
+
+    // releasing the lock and notifying other threads
+    ul.unlock();
+    cv.notify_one();
+
+    return status;
+}
+
+// passes a status to a callback the way the callback API always did, as a list of errors
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::report(const Status &status, std::string_view key, std::string_view value, Callback callback)
+{
+    std::vector<Error_obj> err;
+    if (!status)
+    {
+        err.push_back({status.code, status.detail, std::string(key), std::string(value)});
+    }
+    callback(err);
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::batchCreate(int n, KVE val[], Callback callback)
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    std::vector<Error_obj> err;
+    for (int i = 0; i < n; i++)
+    {
+        const std::string &key = val[i].key;
+        std::string text = val[i].data.dump();
+        long long ttlMs = val[i].expiryMs != -1 ? val[i].expiryMs : (val[i].expiry == -1 ? -1 : val[i].expiry * 1000LL);
+        long long expiry = deadlineFor(ttlMs);
+
+        // Validating sizes of key and value
+
+        if (key.size() > InlineKey::MAX_LEN)
+        {
+            err.push_back({Error_code::KEY_TOO_LONG, "key too long", key, text});
+            continue;
+        }
+
+        if (text.size() > 16 * 1024)
+        {
+            err.push_back({Error_code::VALUE_TOO_LONG, "Value too long", key, text});
+            continue;
+        }
+
+        try
+        {
+            if (findNode(key))
+            {
+                err.push_back({Error_code::KEY_ALREADY_EXISTS, "key already exists", key, text});
+                continue;
+            }
+
+            if (config.valueEncoding == TEXT)
+            {
+                insertEntry(key, text, expiry, val[i].costHint);
+            }
+            else
+            {
+                insertEntry(key, encodeValue(val[i].data), expiry, val[i].costHint);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            err.push_back({Error_code::UNKNOWN_ERROR, std::string(e.what()), key, text});
+        }
+    }
+
+    debugValidate();
+    exportFile();
+    ul.unlock();
+    cv.notify_one();
+    callback(err);
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::deleteKey(std::string_view key, Callback callback)
+{
+    report(tryDeleteKey(key), key, "", callback);
+}
+
+template <class EvictionPolicy>
+Status BasicKVcache<EvictionPolicy>::tryDeleteKey(std::string_view key)
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    Status status;
+    // checking if the key exists
+    Node *node = findNode(key);
+    if (node)
+    {
+        if (mrc.enabled())
+        {
+            mrc.forget(node->key.hash());
+        }
+        eraseNode(node);
+        exportFile();
+    }
+    else
+    {
+        status = {false, Error_code::KEY_NOT_FOUND, "key not found"};
+    }
+
+    debugValidate();
+    ul.unlock();
+    cv.notify_one();
+    return status;
+}
+
+// looks a key up, an expired key is dropped and treated as absent
+template <class EvictionPolicy>
+Node *BasicKVcache<EvictionPolicy>::findNode(std::string_view key)
+{
+    if (key.size() > InlineKey::MAX_LEN)
+    {
+        return nullptr;
+    }
+
+    Node *node = cache.find(InlineKey(key));
+    if (!node)
+    {
+        return nullptr;
+    }
+
+    // lazily dropping the key if it expired before the reaper got to it
+    if (isExpired(node))
+    {
+        expireNode(node);
+        return nullptr;
+    }
+
+    return node;
+}
+
+// bytes charged against the capacity for an entry: its node(holding the key), its slot in the
+// index and the policy's bookkeeping, computed once at insert and kept in Node::cost. Value blobs
+// are charged once per blob.
+template <class EvictionPolicy>
+uint32_t BasicKVcache<EvictionPolicy>::entryCost()
+{
+    return sizeof(Node) + sizeof(Node *) + 1 + EvictionPolicy::ENTRY_BYTES;
+}
+
+// validates a JSON text and encodes it, a DOM is only built for the binary encodings. Returns the
+// text itself for TEXT, otherwise the bytes encoded into `encoded`.
+template <class EvictionPolicy>
+std::string_view BasicKVcache<EvictionPolicy>::encodeValue(std::string_view value, std::string &encoded)
+{
+    if (config.valueEncoding != TEXT)
+    {
+        encoded = encodeValue(json::parse(value));
+        return encoded;
+    }
+
+    // rejected values are re-parsed to surface the parser's error message
+    if (!json::accept(value))
+    {
+        json rejected = json::parse(value);
+    }
+    return value;
+}
+
+template <class EvictionPolicy>
+std::string BasicKVcache<EvictionPolicy>::encodeValue(const json &data)
+{
+    std::string bytes;
+    switch (config.valueEncoding)
+    {
+    case MSGPACK:
+        json::to_msgpack(data, bytes);
+        break;
+    case CBOR:
+        json::to_cbor(data, bytes);
+        break;
+    default:
+        bytes = data.dump();
+    }
+    return bytes;
+}
+
+// stored bytes of a value, decompressed if they were stored compressed
+template <class EvictionPolicy>
+std::string BasicKVcache<EvictionPolicy>::unpack(const char *bytes, size_t len, size_t rawLen)
+{
+    if (len < rawLen)
+    {
+        return LZCodec::decompress(bytes, len, rawLen);
+    }
+    return std::string(bytes, len);
+}
+
+// adds a new entry, evicting the policy's victims to make room
+template <class EvictionPolicy>
+Node *BasicKVcache<EvictionPolicy>::insertEntry(std::string_view key, std::string_view bytes, long long expiry, uint32_t costHint)
+{
+    // compressing large values when it pays off
+    std::string compressed;
+    bool compress = config.compressAbove > 0 && bytes.size() >= config.compressAbove &&
+                    LZCodec::compress(bytes.data(), bytes.size(), compressed);
+    std::string_view stored = compress ? std::string_view(compressed) : bytes;
+
+    // taking the value first, with dedup on it may already be stored and cost nothing more
+    size_t charged;
+    ValueBlob *value = values.acquire(stored.data(), stored.size(), bytes.size(), charged);
+
+    Node *node;
+    try
+    {
+        uint32_t id = nodes.create(InlineKey(key), value, expiry);
+        node = &nodes[id];
+        node->id = id;
+    }
+    catch (...)
+    {
+        values.release(value);
+        throw;
+    }
+
+    // the defragmenter finds the holder of an unshared value through it
+    if (value->refs == 1)
+    {
+        value->owner = node->id;
+    }
+
+    node->cost = entryCost();
+    node->costHint = costHint;
+    size += node->cost + charged;
+
+    // adding to cache and the eviction policy
+    cache.insert(node);
+    policy.onInsert(node);
+    if (mrc.enabled())
+    {
+        mrc.update(node->key.hash(), node->cost + value->cost);
+    }
+
+    // if expiry is set, scheduling the key on the timing wheel
+    if (expiry != -1)
+    {
+        ttl.schedule(node);
+    }
+
+    // evicting until the entries fit, never the new entry itself
+    while (size > capacity)
+    {
+        Node *victim = policy.selectVictim();
+        if (!victim || victim == node)
+        {
+            break;
+        }
+        eraseNode(victim);
+    }
+
+    return node;
+}
+
+// drops an expired node, unlike an evicted one it misses at any capacity from now on
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::expireNode(Node *node)
+{
+    if (mrc.enabled())
+    {
+        mrc.forget(node->key.hash());
+    }
+    eraseNode(node);
+}
+
+// unlinks a node from the eviction policy and the index, returns its memory to the slab and the arena
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::eraseNode(Node *node)
+{
+    size -= node->cost + values.release(node->value);
+
+    ttl.cancel(node);
+    policy.onRemove(node);
+    cache.erase(node);
+
+    nodes.destroy(node->id);
+}
+
+template <class EvictionPolicy>
+bool BasicKVcache<EvictionPolicy>::validate()
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    bool valid = checkInvariants();
+
+    ul.unlock();
+    cv.notify_one();
+    return valid;
+}
+
+// walks the index, the eviction policy and the timers checking that their bookkeeping agrees, must hold the lock
+template <class EvictionPolicy>
+bool BasicKVcache<EvictionPolicy>::checkInvariants()
+{
+    long long total = 0;
+    size_t entries = 0, timers = 0;
+    bool valid = true;
+    std::unordered_map<ValueBlob *, uint32_t> refs;
+
+    cache.forEach([&](Node *node)
+                  {
+        entries++;
+        total += node->cost;
+
+        // charging each value blob once
+        if (refs[node->value]++ == 0)
+        {
+            total += node->value->cost;
+        }
+
+        if (node->cost != entryCost() || node->value->cost != values.blobCost(node->value->len))
+        {
+            std::cerr << "invariant: stale cost for " << node->key.str() << std::endl;
+            valid = false;
+        }
+        if (cache.find(node->key) != node)
+        {
+            std::cerr << "invariant: " << node->key.str() << " missing from the index" << std::endl;
+            valid = false;
+        }
+        if ((node->expiry != -1) != ttl.scheduled(node))
+        {
+            std::cerr << "invariant: timer out of sync for " << node->key.str() << std::endl;
+            valid = false;
+        }
+        timers += ttl.scheduled(node); });
+
+    if (!policy.check(entries))
+    {
+        std::cerr << "invariant: eviction policy out of sync with " << entries << " entries" << std::endl;
+        valid = false;
+    }
+
+    for (auto [blob, count] : refs)
+    {
+        if (blob->refs != count)
+        {
+            std::cerr << "invariant: value blob has " << blob->refs << " refs but " << count << " holders" << std::endl;
+            valid = false;
+        }
+    }
+
+    // an entry bigger than the whole capacity is still stored, alone
+    if (total != size || (size > capacity && entries > 1))
+    {
+        std::cerr << "invariant: size " << size << " but entries cost " << total << " of " << capacity << std::endl;
+        valid = false;
+    }
+    if (entries != cache.size() || entries != nodes.size() || timers != ttl.size())
+    {
+        std::cerr << "invariant: " << entries << " nodes, " << cache.size() << " indexed, " << ttl.size() << " timers" << std::endl;
+        valid = false;
+    }
+
+    return valid;
+}
+
+// with KVCACHE_DEBUG defined, validates the cache after every write, must hold the lock
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::debugValidate()
+{
+#ifdef KVCACHE_DEBUG
+    if (!checkInvariants())
+    {
+        std::abort();
+    }
+#endif
+}
+
+// checks whether a node's TTL has passed
+template <class EvictionPolicy>
+bool BasicKVcache<EvictionPolicy>::isExpired(Node *node)
+{
+    if (node->expiry == -1)
+    {
+        return false;
+    }
+
+    // the cached clock is never ahead of the real one, a deadline it has reached has passed
+    return node->expiry <= nowMs();
+}
+
+// converts a TTL to a deadline, spreading it by the configured jitter
+template <class EvictionPolicy>
+long long BasicKVcache<EvictionPolicy>::deadlineFor(long long ttlMs)
+{
+    if (ttlMs == -1)
+    {
+        return -1;
+    }
+
+    long long window = ttlMs * config.ttlJitterPercent / 100 + config.ttlJitterMs;
+    long long jitter = window > 0 ? std::uniform_int_distribution<long long>(0, window)(rng) : 0;
+
+    // the cached clock may lag by a tick, rounding up so that the deadline is never early
+    return nowMs() + ttlMs + CLOCK_TICK_MS + jitter;
+}
+
+// cached monotonic time in milliseconds
+template <class EvictionPolicy>
+long long BasicKVcache<EvictionPolicy>::nowMs()
+{
+    return clockMs.load(std::memory_order_relaxed);
+}
+
+// reads the monotonic clock in milliseconds
+template <class EvictionPolicy>
+long long BasicKVcache<EvictionPolicy>::readClock()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// reads the wall clock in milliseconds, only used to persist deadlines
+template <class EvictionPolicy>
+long long BasicKVcache<EvictionPolicy>::wallClockMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// removes expired entries until the slice's key or time budget runs out, returns the number removed
+template <class EvictionPolicy>
+int BasicKVcache<EvictionPolicy>::reapSlice()
+{
+    auto start = std::chrono::steady_clock::now();
+    auto budget = std::chrono::microseconds(config.reapSliceMicros);
+    int removed = 0;
+
+    // expiring in small chunks so that the time budget is checked regularly
+    while (removed < config.reapSliceKeys)
+    {
+        int chunk = std::min(REAP_CHUNK, config.reapSliceKeys - removed);
+        int n = ttl.advance(nowMs(), chunk, [this](Node *node)
+                            { expireNode(node); });
+        removed += n;
+
+        if (n < chunk || (config.reapSliceMicros > 0 && std::chrono::steady_clock::now() - start >= budget))
+        {
+            break;
+        }
+    }
+
+    return removed;
+}
+
+// evicts the policy's victims until the slice's key or time budget runs out or the entries
+// fit capacityTarget, returns the number removed
+template <class EvictionPolicy>
+int BasicKVcache<EvictionPolicy>::shrinkSlice()
+{
+    auto start = std::chrono::steady_clock::now();
+    auto budget = std::chrono::microseconds(config.reapSliceMicros);
+    int removed = 0;
+
+    Node *victim;
+    while (size > capacityTarget && removed < config.reapSliceKeys && (victim = policy.selectVictim()))
+    {
+        eraseNode(victim);
+        removed++;
+
+        if (removed % REAP_CHUNK == 0 && config.reapSliceMicros > 0 && std::chrono::steady_clock::now() - start >= budget)
+        {
+            break;
+        }
+    }
+
+    // new entries can't grow the cache back while it is shrinking
+    capacity = std::max(capacityTarget, size);
+    return removed;
+}
+
+// brings the capacity to capacityTarget, evicting one slice at a time and releasing the lock
+// between slices, must hold the lock
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::resize(std::unique_lock<std::mutex> &ul)
+{
+    int removed = 0, slice;
+    while (!stopping && (slice = shrinkSlice()) > 0)
+    {
+        removed += slice;
+
+        ul.unlock();
+        cv.notify_one();
+        std::this_thread::yield();
+        ul.lock();
+    }
+
+    if (removed > 0)
+    {
+        // handing the emptied slab pages back, evicting alone frees no memory
+        slab.trim();
+        debugValidate();
+        exportFile();
+    }
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::setCapacity(long long bytes)
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+
+    // the memory monitor keeps the capacity within the new bound
+    config.capacity = capacityTarget = std::max(bytes, 0LL);
+    resize(ul);
+
+    ul.unlock();
+    cv.notify_one();
+}
+
+template <class EvictionPolicy>
+long long BasicKVcache<EvictionPolicy>::getCapacity()
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+    return capacity;
+}
+
+template <class EvictionPolicy>
+MemoryStats BasicKVcache<EvictionPolicy>::memoryStats()
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+    return {size, slab.resident() + nodes.reserved(), slab.unused()};
+}
+
+template <class EvictionPolicy>
+double BasicKVcache<EvictionPolicy>::estimateHitRatio(long long bytes)
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+    return mrc.hitRatio(bytes);
+}
+
+// sizes the cache to the memory its cgroup has left: the entries may grow into the memory free
+// below the headroom and give back what the cgroup uses above it. Stalling on memory gives back an
+// eighth of the entries on top.
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::followMemory()
+{
+    // reading the cgroup's files outside the lock
+    long long current, limit;
+    double stall;
+    try
+    {
+        current = memory.current();
+        limit = memory.limit();
+        stall = memory.pressure();
+    }
+    catch (const std::exception &e)
+    {
+        return;
+    }
+
+    if ((current == -1 || limit == -1) && stall == -1)
+    {
+        return;
+    }
+
+    std::unique_lock ul(m);
+    long long target = capacityTarget;
+    if (current != -1 && limit != -1)
+    {
+        target = size + (limit - limit * config.memoryHeadroomPercent / 100 - current);
+    }
+    if (stall > config.memoryPressureLimit)
+    {
+        target = std::min(target, size - size / 8);
+    }
+
+    capacityTarget = std::clamp(target, std::min(config.minCapacity, config.capacity), config.capacity);
+    resize(ul);
+}
+
+// moves the values held in the slab page being drained, from chunks[next] on up to the slice's
+// budget. Returns false once every chunk has been tried.
+template <class EvictionPolicy>
+bool BasicKVcache<EvictionPolicy>::defragSlice(const std::vector<void *> &chunks, size_t &next)
+{
+    size_t end = std::min(chunks.size(), next + config.defragSliceValues);
+    for (; next < end && slab.draining(); next++)
+    {
+        // the chunk may have been freed since the page's chunks were listed, its holder then no
+        // longer points at it
+        ValueBlob *blob = static_cast<ValueBlob *>(chunks[next]);
+        Node *node = &nodes[blob->owner];
+        if (node->value != blob || cache.find(node->key) != node)
+        {
+            continue;
+        }
+
+        // shared and pinned values stay where they are
+        if (blob->refs == 1 && blob->pins.load(std::memory_order_acquire) == 0)
+        {
+            node->value = values.relocate(blob);
+        }
+    }
+    return next < chunks.size();
+}
+
+// drains sparsely used slab pages one after the other, one slice at a time, releasing the lock
+// between slices. A page whose values can't all be moved after trying each of them once is given up.
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::defragPass()
+{
+    std::unique_lock ul(m);
+    while (!stopping && slab.startDrain())
+    {
+        std::vector<void *> chunks = slab.drainingChunks();
+        size_t next = 0;
+        try
+        {
+            while (defragSlice(chunks, next) && slab.draining() && !stopping)
+            {
+                ul.unlock();
+                cv.notify_one();
+                std::this_thread::yield();
+                ul.lock();
+            }
+        }
+        catch (const std::bad_alloc &)
+        {
+            // no room to move the values to
+            slab.abandonDrain();
+            break;
+        }
+
+        if (slab.draining())
+        {
+            slab.abandonDrain();
+            break;
+        }
+        debugValidate();
+    }
+}
+
+// ticker thread: refreshes the cached clock every tick, without ever taking the lock
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::tickerLoop()
+{
+    while (!stopping)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(CLOCK_TICK_MS));
+        clockMs.store(readClock(), std::memory_order_relaxed);
+    }
+}
+
+// reaper thread: removes expired entries every reapIntervalMs, one budgeted slice at a time,
+// releasing the lock between slices. Retired values are collected at the start of every pass. With
+// followMemoryPressure on, it also resizes the cache every memoryCheckIntervalMs, with defragment
+// on it defragments the slab every defragIntervalMs.
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::reaperLoop()
+{
+    long long nextReap = nowMs() + config.reapIntervalMs;
+    long long nextMemoryCheck = nowMs();
+    long long nextDefrag = nowMs() + config.defragIntervalMs;
+    while (!stopping)
+    {
+        // sleeping until the earliest task is due, the destructor wakes it up
+        long long next = nextReap;
+        if (config.followMemoryPressure)
+        {
+            next = std::min(next, nextMemoryCheck);
+        }
+        if (config.defragment)
+        {
+            next = std::min(next, nextDefrag);
+        }
+        {
+            std::unique_lock ul(m);
+            long long wait = next - nowMs();
+            if (wait > 0)
+            {
+                cv.wait_for(ul, std::chrono::milliseconds(wait), [this]()
+                            { return stopping.load(); });
+            }
+        }
+        if (stopping)
+        {
+            break;
+        }
+
+        if (config.followMemoryPressure && nowMs() >= nextMemoryCheck)
+        {
+            nextMemoryCheck = nowMs() + config.memoryCheckIntervalMs;
+            followMemory();
+        }
+
+        if (config.defragment && nowMs() >= nextDefrag)
+        {
+            defragPass();
+            nextDefrag = nowMs() + config.defragIntervalMs;
+        }
+
+        if (nowMs() < nextReap)
+        {
+            continue;
+        }
+        nextReap = nowMs() + config.reapIntervalMs;
+
+        std::unique_lock ul(m);
+
+        // freeing the values released while readers still had them pinned
+        values.collect();
+
+        int removed = 0, slice;
+        while (!stopping && (slice = reapSlice()) > 0)
+        {
+            removed += slice;
+
+            // giving waiting getKey/putKey calls a chance between slices
+            ul.unlock();
+            cv.notify_one();
+            std::this_thread::yield();
+            ul.lock();
+        }
+
+        // persisting only when something actually expired
+        if (removed > 0)
+        {
+            debugValidate();
+            exportFile();
+        }
+    }
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::exportFile()
+{
+    try
+    {
+        // initializing a json object
+        json j = json::object();
+        // deadlines are monotonic, converting them to unix time in ms for the data-store
+        long long now = nowMs(), wallNow = wallClockMs();
+
+        // appending all the entries to the json object from the cache
+        cache.forEach([&](Node *node)
+                      {
+            json &entry = j[node->key.str()];
+            std::string bytes = unpack(node->value->bytes(), node->value->len, node->value->rawLen);
+            entry["data"] = decodeValue(config.valueEncoding, bytes.data(), bytes.size());
+            entry["expiryMs"] = node->expiry == -1 ? -1 : wallNow + (node->expiry - now);
+            if (node->costHint != 1)
+            {
+                entry["costHint"] = node->costHint;
+            } });
+
+        // writing to the file as a json object
+        std::string data = j.dump();
+        ftruncate(fd, 0);
+        lseek(fd, 0, SEEK_SET);
+        write(fd, data.c_str(), data.size());
+    }
+    catch (json::exception &e)
+    {
+        std::cout << "error while exporting ";
+        std::cout << e.what() << std::endl;
+    }
+}
+
+template <class EvictionPolicy>
+void BasicKVcache<EvictionPolicy>::importFile(json &j)
+{
+    std::unique_lock ul(m);
+    cv.wait(ul, []()
+            { return true; });
+    try
+    {
+        long long now = nowMs(), wallNow = wallClockMs();
+
+        // iterating over the json object
+        for (auto [key, value] : j.items())
+        {
+            try
+            {
+                // skipping keys which can't be stored inline
+                if (key.size() > InlineKey::MAX_LEN || findNode(key))
+                {
+                    continue;
+                }
+
+                // older data-stores keep expiry as a unix timestamp in seconds
+                long long wallExpiry = value.contains("expiryMs") ? value["expiryMs"].template get<long long>()
+                                       : value["expiry"] == -1   ? -1
+                                                                 : value["expiry"].template get<long long>() * 1000;
+
+                // skipping the entry if it has expired
+                if (wallExpiry != -1 && wallExpiry < wallNow)
+                {
+                    continue;
+                }
+                long long expiry = wallExpiry == -1 ? -1 : now + (wallExpiry - wallNow);
+
+                // breaking if the capacity is exceeded
+                std::string bytes = encodeValue(value["data"]);
+                long long cost = entryCost() + values.blobCost(bytes.size());
+                if (size + cost > capacity)
+                {
+                    break;
+                }
+
+                insertEntry(key, bytes, expiry, value.value("costHint", 1u));
+            }
+            catch (const std::exception &e)
+            {
+                std::cout << "error while importing(1) ";
+                std::cerr << e.what() << '\n';
+            }
+        }
+    }
+    catch (json::exception &e)
+    {
+        std::cout << "error while importing(2) ";
+        std::cout << e.what() << std::endl;
+    }
+
+    ul.unlock();
+    cv.notify_one();
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef LZ_CODEC_HPP
+#define LZ_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Small LZ77 codec in the spirit of LZ4, used to compress large values.
+//
+// The output is a list of sequences, each one
+//     token: high nibble literal length, low nibble match length - MIN_MATCH(15 means more follows)
+//     extra literal length bytes(255 means more follows)
+//     literals
+//     2-byte little endian match offset
+//     extra match length bytes(255 means more follows)
+// The last sequence ends right after its literals. Matches use a single 4096 entry hash table,
+// trading some ratio for speed.
+class LZCodec
+{
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t MAX_OFFSET = 65535;
+    static constexpr int HASH_BITS = 12;
+
+    static uint32_t read32(const char *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    static uint32_t hash(uint32_t v)
+    {
+        return (v * 2654435761U) >> (32 - HASH_BITS);
+    }
+
+    static void putLength(std::string &out, size_t len)
+    {
+        while (len >= 255)
+        {
+            out.push_back(char(255));
+            len -= 255;
+        }
+        out.push_back(char(len));
+    }
+
+    static size_t getLength(const unsigned char *&in, const unsigned char *end, size_t len)
+    {
+        if (len != 15)
+        {
+            return len;
+        }
+        while (true)
+        {
+            if (in == end)
+            {
+                throw std::runtime_error("corrupt compressed value");
+            }
+            unsigned char b = *in++;
+            len += b;
+            if (b != 255)
+            {
+                return len;
+            }
+        }
+    }
+
+    static void putSequence(std::string &out, const char *literals, size_t literalLen, size_t offset, size_t matchLen)
+    {
+        size_t extraMatch = matchLen ? matchLen - MIN_MATCH : 0;
+        unsigned char token = (literalLen < 15 ? literalLen : 15) << 4 | (extraMatch < 15 ? extraMatch : 15);
+        out.push_back(char(token));
+        if (literalLen >= 15)
+        {
+            putLength(out, literalLen - 15);
+        }
+        out.append(literals, literalLen);
+
+        if (matchLen)
+        {
+            out.push_back(char(offset & 0xFF));
+            out.push_back(char(offset >> 8));
+            if (extraMatch >= 15)
+            {
+                putLength(out, extraMatch - 15);
+            }
+        }
+    }
+
+public:
+    // compresses src into out, returns false if that doesn't make it smaller
+    static bool compress(const char *src, size_t len, std::string &out)
+    {
+        out.clear();
+        if (len < 2 * MIN_MATCH)
+        {
+            return false;
+        }
+        out.reserve(len);
+
+        uint32_t table[1 << HASH_BITS] = {}; // position + 1 of the last occurrence, 0 for none
+        size_t anchor = 0, i = 0;
+
+        while (i + MIN_MATCH <= len)
+        {
+            uint32_t h = hash(read32(src + i));
+            size_t candidate = table[h];
+            table[h] = i + 1;
+
+            if (candidate && i - (candidate - 1) <= MAX_OFFSET && read32(src + candidate - 1) == read32(src + i))
+            {
+                size_t from = candidate - 1, matchLen = MIN_MATCH;
+                while (i + matchLen < len && src[from + matchLen] == src[i + matchLen])
+                {
+                    matchLen++;
+                }
+
+                putSequence(out, src + anchor, i - anchor, i - from, matchLen);
+                i += matchLen;
+                anchor = i;
+            }
+            else
+            {
+                i++;
+            }
+
+            if (out.size() >= len)
+            {
+                return false;
+            }
+        }
+
+        putSequence(out, src + anchor, len - anchor, 0, 0);
+        return out.size() < len;
+    }
+
+    // decompresses into a string of rawLen bytes
+    static std::string decompress(const char *src, size_t len, size_t rawLen)
+    {
+        std::string out(rawLen, '\0');
+        const unsigned char *in = reinterpret_cast<const unsigned char *>(src), *end = in + len;
+        size_t pos = 0;
+
+        while (in < end)
+        {
+            unsigned char token = *in++;
+
+            size_t literalLen = getLength(in, end, token >> 4);
+            if (literalLen > size_t(end - in) || literalLen > rawLen - pos)
+            {
+                throw std::runtime_error("corrupt compressed value");
+            }
+            memcpy(&out[pos], in, literalLen);
+            in += literalLen;
+            pos += literalLen;
+
+            // the last sequence has no match
+            if (in == end)
+            {
+                break;
+            }
+
+            if (end - in < 2)
+            {
+                throw std::runtime_error("corrupt compressed value");
+            }
+            size_t offset = in[0] | size_t(in[1]) << 8;
+            in += 2;
+            size_t matchLen = getLength(in, end, token & 15) + MIN_MATCH;
+            if (offset == 0 || offset > pos || matchLen > rawLen - pos)
+            {
+                throw std::runtime_error("corrupt compressed value");
+            }
+
+            // byte by byte, matches may overlap the bytes they produce
+            for (size_t k = 0; k < matchLen; k++, pos++)
+            {
+                out[pos] = out[pos - offset];
+            }
+        }
+
+        if (pos != rawLen)
+        {
+            throw std::runtime_error("corrupt compressed value");
+        }
+        return out;
+    }
+};
+
+#endif
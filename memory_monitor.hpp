@@ -0,0 +1,75 @@
+#ifndef MEMORY_MONITOR_HPP
+#define MEMORY_MONITOR_HPP
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Reads the memory usage, limit and pressure of the process's cgroup(v2).
+//
+// memory.current and memory.max give the usage and the hard limit in bytes, memory.pressure the
+// PSI averages. Files which are missing(no cgroup v2, no memory controller, no PSI) read as unknown.
+class MemoryMonitor
+{
+    std::string dir;
+
+    // first line of a file in the cgroup's directory, empty if it can't be read
+    std::string readLine(const char *name) const
+    {
+        std::ifstream in(dir + "/" + name);
+        std::string line;
+        getline(in, line);
+        return line;
+    }
+
+    // cgroup directory of this process, from the unified hierarchy's "0::/path" line
+    static std::string ownCgroup()
+    {
+        std::ifstream in("/proc/self/cgroup");
+        std::string line;
+        while (getline(in, line))
+        {
+            if (line.compare(0, 3, "0::") == 0)
+            {
+                return "/sys/fs/cgroup" + (line.size() > 4 ? line.substr(3) : "");
+            }
+        }
+        return "/sys/fs/cgroup";
+    }
+
+public:
+    // dir is a cgroup's directory, empty for the cgroup this process runs in
+    MemoryMonitor(const std::string &dir = "") : dir(dir.empty() ? ownCgroup() : dir) {}
+
+    // bytes currently charged to the cgroup, -1 if unknown
+    long long current() const
+    {
+        std::string line = readLine("memory.current");
+        return line.empty() ? -1 : std::stoll(line);
+    }
+
+    // the cgroup's hard limit in bytes, -1 if unknown or unlimited
+    long long limit() const
+    {
+        std::string line = readLine("memory.max");
+        return line.empty() || line == "max" ? -1 : std::stoll(line);
+    }
+
+    // share of the last 10 seconds in which some task stalled on memory(PSI "some avg10"), in
+    // percent, -1 if unknown
+    double pressure() const
+    {
+        std::istringstream in(readLine("memory.pressure"));
+        std::string word;
+        while (in >> word)
+        {
+            if (word.compare(0, 6, "avg10=") == 0)
+            {
+                return std::stod(word.substr(6));
+            }
+        }
+        return -1;
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef MISS_RATIO_CURVE_HPP
+#define MISS_RATIO_CURVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+// Online estimate of the hit ratio an LRU cache of any capacity would get on the reads seen so
+// far, SHARDS style(spatially hashed sampling of reuse distances).
+//
+// Only the keys whose hash falls below a threshold, a `rate` share of them, are tracked. For those
+// the estimator keeps a stack ordered by last access, the bytes of the entries accessed since a
+// key's previous access, scaled up by 1 / rate, estimate its reuse distance: a read hits in an LRU
+// cache of capacity C iff its reuse distance is at most C. Distances are counted in a log-linear
+// histogram(16 buckets per power of two), so curves at any capacity are read off one histogram
+// without running shadow caches.
+//
+// Which keys fall in the sample weighs a lot on skewed workloads(one hot key more or less), so the
+// estimate is adjusted as in SHARDS_adj: the sampled reads missing from, or in excess of, rate * all
+// reads are counted as hits at any capacity, or taken off them.
+//
+// The stack is a Fenwick tree of the bytes last accessed at each logical time, renumbered when the
+// times run out, so an access costs O(log tracked keys). Memory grows with rate * distinct keys.
+// Not thread safe, callers are expected to hold their own lock.
+class MissRatioCurve
+{
+    static constexpr int SUB_BUCKETS = 16;
+    static constexpr int BUCKETS = (64 - 3) * SUB_BUCKETS;
+    static constexpr size_t MIN_TIMES = 1024;
+    static constexpr uint64_t HASH_RANGE = 1ULL << 24;
+
+    struct Sample
+    {
+        size_t time = 0; // last access, slot in the Fenwick tree, 0 until first touched
+        uint64_t bytes = 0;
+    };
+
+    double rate;
+    uint64_t threshold;                           // keys whose spread hash is below it are sampled
+    std::unordered_map<uint64_t, Sample> samples; // keyed by the key's hash
+    std::vector<uint64_t> tree;                   // Fenwick tree of bytes by last access time
+    size_t now;                                   // next logical time, times start at 1
+    std::vector<uint64_t> histogram;              // sampled reads by reuse distance bucket
+    uint64_t reads;                               // sampled reads, including the cold ones
+    uint64_t allReads;                            // reads of any key, sampled or not
+
+    // spreads the hash so that sampling does not follow the bits the index probes with
+    bool sampled(uint64_t hash) const
+    {
+        return ((hash * 0x9E3779B97F4A7C15ULL) >> 40) < threshold;
+    }
+
+    static int bucketOf(uint64_t distance)
+    {
+        if (distance < SUB_BUCKETS)
+        {
+            return distance;
+        }
+        int exponent = 63 - __builtin_clzll(distance);
+        return (exponent - 3) * SUB_BUCKETS + ((distance >> (exponent - 4)) & (SUB_BUCKETS - 1));
+    }
+
+    // smallest distance of a bucket, and the width of its range
+    static uint64_t bucketLow(int bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+        {
+            return bucket;
+        }
+        int exponent = bucket / SUB_BUCKETS + 3;
+        return uint64_t(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 4);
+    }
+
+    static uint64_t bucketWidth(int bucket)
+    {
+        return bucket < SUB_BUCKETS ? 1 : 1ULL << (bucket / SUB_BUCKETS - 1);
+    }
+
+    void add(size_t time, int64_t bytes)
+    {
+        for (; time < tree.size(); time += time & -time)
+        {
+            tree[time] += bytes;
+        }
+    }
+
+    // bytes last accessed at times 1..time
+    uint64_t prefix(size_t time) const
+    {
+        uint64_t sum = 0;
+        for (; time > 0; time -= time & -time)
+        {
+            sum += tree[time];
+        }
+        return sum;
+    }
+
+    // renumbers the tracked keys 1..n in access order, leaving room for as many accesses again
+    void compact()
+    {
+        std::vector<Sample *> order;
+        order.reserve(samples.size());
+        for (auto &entry : samples)
+        {
+            order.push_back(&entry.second);
+        }
+        std::sort(order.begin(), order.end(), [](const Sample *a, const Sample *b)
+                  { return a->time < b->time; });
+
+        tree.assign(std::max(MIN_TIMES, 2 * (order.size() + 1)), 0);
+        now = 1;
+        for (Sample *sample : order)
+        {
+            sample->time = now++;
+            add(sample->time, sample->bytes);
+        }
+    }
+
+    // makes the sample the most recently accessed one, now taking `bytes`
+    void touch(Sample &sample, uint64_t bytes)
+    {
+        if (now == tree.size())
+        {
+            compact();
+        }
+        if (sample.time != 0)
+        {
+            add(sample.time, -int64_t(sample.bytes));
+        }
+        sample.bytes = bytes;
+        sample.time = now++;
+        add(sample.time, sample.bytes);
+    }
+
+public:
+    // rate in [0, 1] is the share of keys sampled, 0 disables the estimator
+    explicit MissRatioCurve(double rate)
+        : rate(std::min(std::max(rate, 0.0), 1.0)), tree(MIN_TIMES, 0), now(1), histogram(BUCKETS, 0), reads(0), allReads(0)
+    {
+        threshold = this->rate * HASH_RANGE;
+    }
+
+    bool enabled() const
+    {
+        return threshold > 0;
+    }
+
+    // a read of the key, hit or miss
+    void reference(uint64_t hash)
+    {
+        allReads++;
+        if (!sampled(hash))
+        {
+            return;
+        }
+        reads++;
+
+        auto it = samples.find(hash);
+        if (it == samples.end())
+        {
+            // never stored or deleted since, a miss at any capacity
+            return;
+        }
+
+        Sample &sample = it->second;
+        uint64_t since = prefix(now - 1) - prefix(sample.time);
+        histogram[bucketOf(uint64_t(since / rate) + sample.bytes)]++;
+        touch(sample, sample.bytes);
+    }
+
+    // a write of the key, which now takes `bytes`
+    void update(uint64_t hash, uint64_t bytes)
+    {
+        if (!sampled(hash))
+        {
+            return;
+        }
+
+        touch(samples[hash], bytes);
+    }
+
+    // the key was deleted or expired, its next read misses whatever the capacity
+    void forget(uint64_t hash)
+    {
+        if (!sampled(hash))
+        {
+            return;
+        }
+
+        auto it = samples.find(hash);
+        if (it != samples.end())
+        {
+            add(it->second.time, -int64_t(it->second.bytes));
+            samples.erase(it);
+        }
+    }
+
+    // share of the sampled reads that would have hit in an LRU cache of `capacity` bytes, 0 before
+    // any sampled read
+    double hitRatio(long long capacity) const
+    {
+        if (reads == 0 || capacity <= 0)
+        {
+            return 0;
+        }
+
+        // the bucket holding the capacity counts in proportion of the part of its range below it
+        double hits = 0;
+        uint64_t bytes = capacity;
+        for (int i = 0; i < BUCKETS && bucketLow(i) <= bytes; i++)
+        {
+            uint64_t covered = std::min(bytes - bucketLow(i) + 1, bucketWidth(i));
+            hits += double(histogram[i]) * covered / bucketWidth(i);
+        }
+        double expected = allReads * rate;
+        hits += expected - reads;
+        return std::min(std::max(hits / expected, 0.0), 1.0);
+    }
+
+    // reads the estimate is based on
+    uint64_t sampledReads() const
+    {
+        return reads;
+    }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef NODE_HPP
+#define NODE_HPP
+
+#include <cstdint>
+#include "inline_key.hpp"
+#include "value_pool.hpp"
+
+// Cache entry. Nodes live in a NodeArena and are addressed by their id, the eviction policy keeps
+// its own bookkeeping for each id next to them(or, for a sampling policy, just a stamp in the node).
+class Node
+{
+public:
+    InlineKey key;
+    ValueBlob *value;  // encoded value bytes(see ValueEncoding), possibly shared with other nodes
+    uint32_t cost;     // bytes charged against the capacity for the node itself, fixed at insert
+    uint32_t costHint; // how expensive the value is to recompute(1 by default), weighed by size aware policies
+    long long expiry;  // deadline on the monotonic clock in ms, -1 if the key never expires
+    uint32_t id;       // position in the node arena
+    uint32_t stamp;    // last access on the clock of sampling eviction policies(24 bits)
+
+    // intrusive links of the TTL timing wheel
+    Node *timerNext;
+    Node **timerPprev;
+
+    Node(const InlineKey &key, ValueBlob *value = nullptr, long long expiry = -1)
+        : key(key), value(value), cost(0), costHint(1), expiry(expiry), id(0), stamp(0), timerNext(nullptr), timerPprev(nullptr) {}
+};
+
+#endif
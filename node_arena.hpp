@@ -0,0 +1,87 @@
+#ifndef NODE_ARENA_HPP
+#define NODE_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "page_source.hpp"
+
+// Contiguous pool of T objects addressed by 32-bit ids.
+//
+// Objects live in chunks of CHUNK_SIZE consecutive slots taken from a PageSource, so neighbouring
+// ids are neighbours in memory and addresses stay stable as the pool grows. Freed ids are reused
+// before the pool grows.
+//
+// Not thread safe, callers are expected to hold their own lock.
+template <class T>
+class NodeArena
+{
+    static_assert(std::is_trivially_destructible<T>::value, "arena objects are released without running destructors");
+
+public:
+    static constexpr uint32_t CHUNK_BITS = 12;
+    static constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+
+private:
+    PageSource &source;
+    std::vector<T *> chunks;
+    std::vector<uint32_t> freeIds;
+    uint32_t used; // ids below `used` have been handed out at least once
+
+public:
+    explicit NodeArena(PageSource &source) : source(source), used(0) {}
+
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    T &operator[](uint32_t id)
+    {
+        return chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)];
+    }
+
+    // constructs a T in a free slot and returns its id
+    template <class... Args>
+    uint32_t create(Args &&...args)
+    {
+        uint32_t id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        else
+        {
+            if (used == chunks.size() * CHUNK_SIZE)
+            {
+                chunks.reserve(chunks.size() + 1);
+                chunks.push_back(static_cast<T *>(source.allocate(sizeof(T) * CHUNK_SIZE)));
+            }
+            id = used++;
+        }
+
+        new (&(*this)[id]) T(std::forward<Args>(args)...);
+        return id;
+    }
+
+    void destroy(uint32_t id)
+    {
+        freeIds.push_back(id);
+    }
+
+    // number of live objects
+    size_t size() const
+    {
+        return used - freeIds.size();
+    }
+
+    // bytes held from the system
+    size_t reserved() const
+    {
+        return chunks.size() * CHUNK_SIZE * sizeof(T);
+    }
+};
+
+#endif
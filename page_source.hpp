@@ -0,0 +1,165 @@
+#ifndef PAGE_SOURCE_HPP
+#define PAGE_SOURCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+// Hands out the large, long lived blocks the cache's heap is built from(slab pages, node arena
+// chunks).
+//
+// With huge pages on, blocks are carved from HUGE_PAGE_SIZE regions mapped with MAP_HUGETLB or,
+// when no huge pages are reserved, from huge page aligned regular mappings advised with
+// MADV_HUGEPAGE so that transparent huge pages can back them. Either way the heap is covered by
+// far fewer TLB entries. With huge pages off, every block comes from malloc.
+//
+// Blocks are only unmapped when the source is destroyed, release() hands the memory of an unused
+// block back to the system meanwhile, keeping its addresses.
+// Not thread safe, callers are expected to hold their own lock.
+class PageSource
+{
+public:
+    static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+    static constexpr size_t BLOCK_ALIGN = 64;
+
+private:
+    struct Region
+    {
+        void *start;
+        size_t bytes;
+        bool mapped; // mmap-ed, malloc-ed otherwise
+    };
+
+    bool huge;
+    std::vector<Region> regions;
+    char *cursor; // free part of the current huge page region
+    char *end;
+    size_t hugeTlbBytes;
+
+    static size_t roundUp(size_t n, size_t to)
+    {
+        return (n + to - 1) / to * to;
+    }
+
+    // maps bytes(a multiple of HUGE_PAGE_SIZE) backed by huge pages if at all possible
+    char *mapHuge(size_t bytes)
+    {
+        regions.reserve(regions.size() + 1);
+
+#ifdef MAP_HUGETLB
+        void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            regions.push_back({p, bytes, true});
+            hugeTlbBytes += bytes;
+            return static_cast<char *>(p);
+        }
+#endif
+
+        // over-mapping by a huge page and trimming, transparent huge pages need aligned regions
+        size_t mappedBytes = bytes + HUGE_PAGE_SIZE;
+        void *raw = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        char *start = static_cast<char *>(raw);
+        char *aligned = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE_SIZE));
+        if (aligned > start)
+        {
+            munmap(start, aligned - start);
+        }
+        size_t tail = start + mappedBytes - (aligned + bytes);
+        if (tail > 0)
+        {
+            munmap(aligned + bytes, tail);
+        }
+
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+        regions.push_back({aligned, bytes, true});
+        return aligned;
+    }
+
+public:
+    explicit PageSource(bool huge = false) : huge(huge), cursor(nullptr), end(nullptr), hugeTlbBytes(0) {}
+
+    PageSource(const PageSource &) = delete;
+    PageSource &operator=(const PageSource &) = delete;
+
+    ~PageSource()
+    {
+        for (Region &region : regions)
+        {
+            if (region.mapped)
+            {
+                munmap(region.start, region.bytes);
+            }
+            else
+            {
+                std::free(region.start);
+            }
+        }
+    }
+
+    // returns a block of at least bytes bytes, aligned to align(a power of two, at most
+    // HUGE_PAGE_SIZE)
+    void *allocate(size_t bytes, size_t align = BLOCK_ALIGN)
+    {
+        align = align < BLOCK_ALIGN ? BLOCK_ALIGN : align;
+        if (!huge)
+        {
+            regions.reserve(regions.size() + 1);
+            void *p = std::aligned_alloc(align, roundUp(bytes, align));
+            if (!p)
+            {
+                throw std::bad_alloc();
+            }
+            regions.push_back({p, bytes, false});
+            return p;
+        }
+
+        bytes = roundUp(bytes, BLOCK_ALIGN);
+        if (bytes > HUGE_PAGE_SIZE)
+        {
+            return mapHuge(roundUp(bytes, HUGE_PAGE_SIZE));
+        }
+
+        // starting a new region when the block doesn't fit, the rest of the old one stays unused
+        char *start = cursor ? reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(cursor), align)) : nullptr;
+        if (!start || start > end || size_t(end - start) < bytes)
+        {
+            start = mapHuge(HUGE_PAGE_SIZE);
+            end = start + HUGE_PAGE_SIZE;
+        }
+
+        cursor = start + bytes;
+        return start;
+    }
+
+    // gives the memory of a block(or a page aligned part of one) back to the system, the block
+    // reads as zeros once touched again. Returns false if the system kept it, e.g. for part of a
+    // MAP_HUGETLB page.
+    bool release(void *block, size_t bytes)
+    {
+        return madvise(block, bytes, MADV_DONTNEED) == 0;
+    }
+
+    bool hugePages() const
+    {
+        return huge;
+    }
+
+    // bytes backed by explicitly reserved(MAP_HUGETLB) huge pages
+    size_t hugeTlbReserved() const
+    {
+        return hugeTlbBytes;
+    }
+};
+
+#endif
@@ -0,0 +1,371 @@
+#ifndef SLAB_HPP
+#define SLAB_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include "page_source.hpp"
+
+// Size-classed slab allocator.
+//
+// Memory is taken from a PageSource in PAGE_SIZE pages, each page is carved into equally sized
+// chunks of one size class. Chunk sizes grow by GROWTH_FACTOR from MIN_CHUNK up to PAGE_SIZE.
+//
+// Every page keeps its own free list, a class allocates from its partial pages(pages with a free
+// chunk). A page whose last chunk is freed leaves its class and goes to a pool of empty pages any
+// class can take from, so pages move between classes as the mix of sizes shifts. trim() gives the
+// memory of the empty pages back to the system, they are faulted back in when taken again.
+//
+// Defragmentation: startDrain() picks a sparsely used page of a class with at least a page worth
+// of free chunks and stops allocating from it. The caller then moves the page's live chunks(see
+// drainingChunks()) elsewhere, once the last one is freed the page joins the empty pool.
+//
+// Not thread safe, callers are expected to hold their own lock.
+class SlabAllocator
+{
+public:
+    static constexpr size_t PAGE_SIZE = 1 << 20;
+    static constexpr size_t MIN_CHUNK = 16;
+    static constexpr double GROWTH_FACTOR = 1.25;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct FreeChunk
+    {
+        FreeChunk *next;
+    };
+
+    struct Page
+    {
+        char *base;
+        FreeChunk *freeList;
+        char *cursor; // next never used chunk
+        char *end;
+        uint32_t slabClass;  // NONE while the page is in the empty pool
+        uint32_t live;       // chunks handed out
+        uint32_t chunks;     // chunks the page holds in its class
+        uint32_t partialPos; // position in the class's partial list, NONE when full or draining
+        uint32_t stuckAt;    // live chunks when draining the page last had to be abandoned
+        bool trimmed;        // empty and given back to the system
+    };
+
+    struct SlabClass
+    {
+        size_t chunkSize;
+        uint32_t chunksPerPage;
+        std::vector<uint32_t> partial; // pages with a free chunk
+        size_t pages;
+        size_t used; // number of chunks handed out
+    };
+
+    PageSource &source;
+    std::vector<SlabClass> classes;
+    std::vector<Page> pages;
+    std::unordered_map<uintptr_t, uint32_t> pageAt; // page base address to index in pages
+    std::vector<uint32_t> emptyPages;
+    size_t trimmedPages;
+    uint32_t drainPage; // page being drained, NONE if none
+
+    // smallest class whose chunks fit n bytes
+    size_t classFor(size_t n) const
+    {
+        size_t lo = 0, hi = classes.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (classes[mid].chunkSize < n)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if (lo == classes.size())
+        {
+            throw std::bad_alloc();
+        }
+        return lo;
+    }
+
+    uint32_t pageOf(const void *p) const
+    {
+        return pageAt.find(reinterpret_cast<uintptr_t>(p) & ~(PAGE_SIZE - 1))->second;
+    }
+
+    void addPartial(uint32_t id)
+    {
+        SlabClass &slabClass = classes[pages[id].slabClass];
+        pages[id].partialPos = slabClass.partial.size();
+        slabClass.partial.push_back(id);
+    }
+
+    void removePartial(uint32_t id)
+    {
+        SlabClass &slabClass = classes[pages[id].slabClass];
+        uint32_t pos = pages[id].partialPos;
+        slabClass.partial[pos] = slabClass.partial.back();
+        pages[slabClass.partial[pos]].partialPos = pos;
+        slabClass.partial.pop_back();
+        pages[id].partialPos = NONE;
+    }
+
+    // gives a class a page from the empty pool, or a new one
+    uint32_t takePage(size_t classId)
+    {
+        uint32_t id;
+        if (!emptyPages.empty())
+        {
+            id = emptyPages.back();
+            emptyPages.pop_back();
+        }
+        else
+        {
+            pages.reserve(pages.size() + 1);
+            char *base = static_cast<char *>(source.allocate(PAGE_SIZE, PAGE_SIZE));
+            id = pages.size();
+            pageAt[reinterpret_cast<uintptr_t>(base)] = id;
+            pages.push_back({base, nullptr, nullptr, nullptr, NONE, 0, 0, NONE, NONE, false});
+        }
+        if (pages[id].trimmed)
+        {
+            pages[id].trimmed = false;
+            trimmedPages--;
+        }
+
+        SlabClass &slabClass = classes[classId];
+        Page &page = pages[id];
+        page.freeList = nullptr;
+        page.cursor = page.base;
+        page.end = page.base + size_t(slabClass.chunksPerPage) * slabClass.chunkSize;
+        page.slabClass = classId;
+        page.live = 0;
+        page.chunks = slabClass.chunksPerPage;
+        page.stuckAt = NONE;
+        slabClass.pages++;
+        addPartial(id);
+        return id;
+    }
+
+    // returns a page without live chunks to the empty pool
+    void releasePage(uint32_t id)
+    {
+        Page &page = pages[id];
+        if (page.partialPos != NONE)
+        {
+            removePartial(id);
+        }
+        if (drainPage == id)
+        {
+            drainPage = NONE;
+        }
+        classes[page.slabClass].pages--;
+        page.slabClass = NONE;
+        emptyPages.push_back(id);
+    }
+
+public:
+    explicit SlabAllocator(PageSource &source) : source(source), trimmedPages(0), drainPage(NONE)
+    {
+        size_t chunk = MIN_CHUNK;
+        while (true)
+        {
+            classes.push_back({chunk, uint32_t(PAGE_SIZE / chunk), {}, 0, 0});
+            if (chunk == PAGE_SIZE)
+            {
+                break;
+            }
+
+            // keeping chunks pointer aligned
+            size_t next = (size_t(chunk * GROWTH_FACTOR) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+            chunk = next < PAGE_SIZE ? next : PAGE_SIZE;
+        }
+    }
+
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    // bytes actually taken by an allocation of n bytes
+    size_t chunkSize(size_t n) const
+    {
+        return classes[classFor(n)].chunkSize;
+    }
+
+    void *allocate(size_t n)
+    {
+        size_t classId = classFor(n);
+        SlabClass &slabClass = classes[classId];
+        uint32_t id = slabClass.partial.empty() ? takePage(classId) : slabClass.partial.back();
+        Page &page = pages[id];
+
+        // reusing a freed chunk first
+        void *chunk;
+        if (page.freeList)
+        {
+            chunk = page.freeList;
+            page.freeList = page.freeList->next;
+        }
+        else
+        {
+            chunk = page.cursor;
+            page.cursor += slabClass.chunkSize;
+        }
+
+        page.live++;
+        slabClass.used++;
+        if (page.live == page.chunks)
+        {
+            removePartial(id);
+        }
+        return chunk;
+    }
+
+    // n must be the size passed to allocate
+    void deallocate(void *p, size_t n)
+    {
+        uint32_t id = pageOf(p);
+        Page &page = pages[id];
+        FreeChunk *chunk = static_cast<FreeChunk *>(p);
+        chunk->next = page.freeList;
+        page.freeList = chunk;
+        page.live--;
+        classes[classFor(n)].used--;
+
+        if (page.live == 0)
+        {
+            releasePage(id);
+        }
+        else if (page.partialPos == NONE && id != drainPage)
+        {
+            addPartial(id);
+        }
+    }
+
+    // starts draining the least used page of a class whose free chunks add up to a page or more,
+    // returns false if no class is fragmented enough
+    bool startDrain()
+    {
+        if (drainPage != NONE)
+        {
+            return true;
+        }
+
+        uint32_t best = NONE;
+        double bestUse = 1;
+        for (SlabClass &slabClass : classes)
+        {
+            if (slabClass.pages * slabClass.chunksPerPage - slabClass.used < slabClass.chunksPerPage)
+            {
+                continue;
+            }
+            for (uint32_t id : slabClass.partial)
+            {
+                double use = double(pages[id].live) / pages[id].chunks;
+                if (use < bestUse && pages[id].live != pages[id].stuckAt)
+                {
+                    best = id;
+                    bestUse = use;
+                }
+            }
+        }
+
+        if (best == NONE)
+        {
+            return false;
+        }
+        removePartial(best);
+        drainPage = best;
+        return true;
+    }
+
+    // true while a page is being drained
+    bool draining() const
+    {
+        return drainPage != NONE;
+    }
+
+    // true if p lies in the page being drained
+    bool draining(const void *p) const
+    {
+        return drainPage != NONE && (reinterpret_cast<uintptr_t>(p) & ~(PAGE_SIZE - 1)) == reinterpret_cast<uintptr_t>(pages[drainPage].base);
+    }
+
+    // chunks handed out from the page being drained. No chunk of the page is handed out again while
+    // it drains, so the list only goes stale by chunks being freed.
+    std::vector<void *> drainingChunks() const
+    {
+        std::vector<void *> live;
+        if (drainPage == NONE)
+        {
+            return live;
+        }
+
+        const Page &page = pages[drainPage];
+        size_t chunkSize = classes[page.slabClass].chunkSize;
+        std::vector<bool> free((page.cursor - page.base) / chunkSize, false);
+        for (FreeChunk *chunk = page.freeList; chunk; chunk = chunk->next)
+        {
+            free[(reinterpret_cast<char *>(chunk) - page.base) / chunkSize] = true;
+        }
+        for (size_t i = 0; i < free.size(); i++)
+        {
+            if (!free[i])
+            {
+                live.push_back(page.base + i * chunkSize);
+            }
+        }
+        return live;
+    }
+
+    // gives up draining, the page's remaining chunks could not be moved
+    void abandonDrain()
+    {
+        if (drainPage == NONE)
+        {
+            return;
+        }
+        pages[drainPage].stuckAt = pages[drainPage].live;
+        addPartial(drainPage);
+        drainPage = NONE;
+    }
+
+    // gives the memory of the empty pages back to the system, returns the bytes given back
+    size_t trim()
+    {
+        size_t trimmed = 0;
+        for (uint32_t id : emptyPages)
+        {
+            if (!pages[id].trimmed && source.release(pages[id].base, PAGE_SIZE))
+            {
+                pages[id].trimmed = true;
+                trimmedPages++;
+                trimmed += PAGE_SIZE;
+            }
+        }
+        return trimmed;
+    }
+
+    // bytes held from the system
+    size_t reserved() const
+    {
+        return pages.size() * PAGE_SIZE;
+    }
+
+    // bytes held from the system and not given back by trim()
+    size_t resident() const
+    {
+        return (pages.size() - trimmedPages) * PAGE_SIZE;
+    }
+
+    // bytes held in empty pages, ready for any class
+    size_t unused() const
+    {
+        return emptyPages.size() * PAGE_SIZE;
+    }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Hierarchical timing wheel with millisecond ticks.
+//
+// Entries are intrusive: T must expose
+//     long long expiry;   // deadline in ms
+//     T *timerNext;       // next entry in the same slot
+//     T **timerPprev;     // address of the pointer pointing at this entry, nullptr when not scheduled
+// so scheduling and cancelling are O(1) and the wheel only holds memory for live timers.
+//
+// Level l has SLOTS slots of 256^l ms each, 4 levels cover ~49 days; farther deadlines
+// are parked in the last slot of the top level and re-placed when it is cascaded.
+template <class T>
+class TimingWheel
+{
+    static constexpr int LEVELS = 4;
+    static constexpr int BITS = 8;
+    static constexpr int SLOTS = 1 << BITS;
+    static constexpr long long MASK = SLOTS - 1;
+
+    T *slots[LEVELS][SLOTS];
+    long long current; // last tick which has been fully processed
+    size_t count;
+
+    static void link(T **slot, T *node)
+    {
+        node->timerNext = *slot;
+        node->timerPprev = slot;
+        if (*slot)
+        {
+            (*slot)->timerPprev = &node->timerNext;
+        }
+        *slot = node;
+    }
+
+    static void unlink(T *node)
+    {
+        *node->timerPprev = node->timerNext;
+        if (node->timerNext)
+        {
+            node->timerNext->timerPprev = node->timerPprev;
+        }
+        node->timerNext = nullptr;
+        node->timerPprev = nullptr;
+    }
+
+    // places a node in the slot matching its deadline, `base` being the next tick to be processed
+    void place(T *node, long long base)
+    {
+        long long deadline = node->expiry < base ? base : node->expiry;
+        long long delta = deadline - base;
+
+        for (int level = 0; level < LEVELS; level++)
+        {
+            if (delta < (1LL << (BITS * (level + 1))))
+            {
+                link(&slots[level][(deadline >> (BITS * level)) & MASK], node);
+                return;
+            }
+        }
+
+        // beyond the wheel's range, parking it in the farthest top level slot
+        int top = LEVELS - 1;
+        link(&slots[top][((base >> (BITS * top)) + MASK) & MASK], node);
+    }
+
+    // moves the entries of a higher level slot down to the levels below
+    void cascade(int level, long long tick)
+    {
+        T **slot = &slots[level][(tick >> (BITS * level)) & MASK];
+        T *node = *slot;
+        *slot = nullptr;
+
+        while (node)
+        {
+            T *next = node->timerNext;
+            place(node, tick);
+            node = next;
+        }
+    }
+
+public:
+    TimingWheel(long long now = 0) : current(now), count(0)
+    {
+        for (int level = 0; level < LEVELS; level++)
+        {
+            for (int i = 0; i < SLOTS; i++)
+            {
+                slots[level][i] = nullptr;
+            }
+        }
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool scheduled(const T *node) const
+    {
+        return node->timerPprev != nullptr;
+    }
+
+    // schedules a node at node->expiry, O(1)
+    void schedule(T *node)
+    {
+        place(node, current + 1);
+        count++;
+    }
+
+    // removes a node from the wheel if scheduled, O(1)
+    void cancel(T *node)
+    {
+        if (!scheduled(node))
+        {
+            return;
+        }
+        unlink(node);
+        count--;
+    }
+
+    // advances the wheel up to `now`, handing at most `limit` due entries to onExpire.
+    // Due entries are unscheduled before onExpire is called. Returns the number expired.
+    template <class F>
+    size_t advance(long long now, size_t limit, F onExpire)
+    {
+        size_t expired = 0;
+
+        // nothing to fire, skipping ahead
+        if (count == 0 && now > current)
+        {
+            current = now;
+        }
+
+        while (current < now)
+        {
+            long long tick = current + 1;
+
+            // cascading the higher levels whose lower bits wrapped around
+            for (int level = LEVELS - 1; level > 0; level--)
+            {
+                if ((tick & ((1LL << (BITS * level)) - 1)) == 0)
+                {
+                    cascade(level, tick);
+                }
+            }
+
+            T **slot = &slots[0][tick & MASK];
+            while (*slot)
+            {
+                if (expired == limit)
+                {
+                    // resuming from this tick on the next call
+                    return expired;
+                }
+
+                T *node = *slot;
+                unlink(node);
+                count--;
+                onExpire(node);
+                expired++;
+            }
+
+            current = tick;
+        }
+
+        return expired;
+    }
+};
+
+#endif
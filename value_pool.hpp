@@ -0,0 +1,252 @@
+#ifndef VALUE_POOL_HPP
+#define VALUE_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include "slab.hpp"
+
+// Immutable value bytes referenced by one or more nodes. A blob and its bytes share one slab
+// chunk, the bytes directly following the header.
+struct ValueBlob
+{
+    uint64_t hash;
+    ValueBlob *nextSameHash;    // other pooled blobs whose hash collides with this one
+    uint32_t refs;              // nodes holding this blob
+    uint32_t len;               // number of stored bytes
+    uint32_t rawLen;            // length before compression, equal to len for uncompressed blobs
+    uint32_t cost;              // bytes charged against the capacity, once per blob
+    std::atomic<uint32_t> pins; // readers holding a view of the bytes, dropped without the lock
+    uint32_t owner;             // id of the node that stored the blob, set by the cache
+
+    bool compressed() const
+    {
+        return len < rawLen;
+    }
+
+    char *bytes()
+    {
+        return reinterpret_cast<char *>(this + 1);
+    }
+
+    const char *bytes() const
+    {
+        return reinterpret_cast<const char *>(this + 1);
+    }
+};
+
+// Hands out value blobs from the slab. With dedup on, blobs are content addressed: storing bytes
+// identical to a live blob's takes another reference on it instead of a new copy.
+//
+// Readers may pin a blob to use its bytes after the lock is released. A blob released while pinned
+// is retired instead of freed, collect() frees it once the last pin is dropped.
+//
+// Not thread safe apart from unpin(), callers are expected to hold their own lock.
+class ValuePool
+{
+    SlabAllocator &slab;
+    bool dedup;
+    std::unordered_map<uint64_t, ValueBlob *> pooled; // by content hash, only used with dedup on
+    std::vector<ValueBlob *> retired;                 // released blobs still pinned by readers
+
+    void free(ValueBlob *blob)
+    {
+        blob->pins.~atomic();
+        slab.deallocate(blob, sizeof(ValueBlob) + blob->len);
+    }
+
+    ValueBlob *findPooled(const char *bytes, size_t len, size_t rawLen, uint64_t hash)
+    {
+        auto it = pooled.find(hash);
+        for (ValueBlob *blob = it == pooled.end() ? nullptr : it->second; blob; blob = blob->nextSameHash)
+        {
+            if (blob->len == len && blob->rawLen == rawLen && memcmp(blob->bytes(), bytes, len) == 0)
+            {
+                return blob;
+            }
+        }
+        return nullptr;
+    }
+
+    void unpool(ValueBlob *blob)
+    {
+        auto it = pooled.find(blob->hash);
+        ValueBlob **link = &it->second;
+        while (*link != blob)
+        {
+            link = &(*link)->nextSameHash;
+        }
+        *link = blob->nextSameHash;
+
+        if (!it->second)
+        {
+            pooled.erase(it);
+        }
+    }
+
+public:
+    ValuePool(SlabAllocator &slab, bool dedup = false) : slab(slab), dedup(dedup) {}
+
+    // 64-bit hash of a byte string, eight bytes at a time
+    static uint64_t hashBytes(const char *bytes, size_t len)
+    {
+        uint64_t h = len * 0x9E3779B97F4A7C15ULL;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            h = (h ^ word) * 0xBF58476D1CE4E5B9ULL;
+            h ^= h >> 31;
+        }
+
+        uint64_t tail = 0;
+        memcpy(&tail, bytes + i, len - i);
+        h = (h ^ tail) * 0x94D049BB133111EBULL;
+        return h ^ (h >> 32);
+    }
+
+    // bytes charged for a blob holding len bytes
+    size_t blobCost(size_t len) const
+    {
+        return slab.chunkSize(sizeof(ValueBlob) + len);
+    }
+
+    // returns a blob holding the bytes(rawLen long once decompressed), `charged` is set to the
+    // bytes newly charged(0 when shared)
+    ValueBlob *acquire(const char *bytes, size_t len, size_t rawLen, size_t &charged)
+    {
+        uint64_t hash = dedup ? hashBytes(bytes, len) : 0;
+        if (dedup)
+        {
+            ValueBlob *blob = findPooled(bytes, len, rawLen, hash);
+            if (blob)
+            {
+                blob->refs++;
+                charged = 0;
+                return blob;
+            }
+        }
+
+        ValueBlob *blob = static_cast<ValueBlob *>(slab.allocate(sizeof(ValueBlob) + len));
+        blob->hash = hash;
+        blob->nextSameHash = nullptr;
+        blob->refs = 1;
+        blob->len = len;
+        blob->rawLen = rawLen;
+        blob->cost = blobCost(len);
+        new (&blob->pins) std::atomic<uint32_t>(0);
+        memcpy(blob->bytes(), bytes, len);
+
+        if (dedup)
+        {
+            ValueBlob *&head = pooled[hash];
+            blob->nextSameHash = head;
+            head = blob;
+        }
+
+        charged = blob->cost;
+        return blob;
+    }
+
+    // drops a reference, returns the bytes released(0 while other nodes still hold the blob). The
+    // bytes are no longer charged once released, even if readers keep the blob pinned for a while.
+    size_t release(ValueBlob *blob)
+    {
+        if (--blob->refs > 0)
+        {
+            return 0;
+        }
+
+        if (dedup)
+        {
+            unpool(blob);
+        }
+
+        size_t cost = blob->cost;
+        // pins are only taken under the lock from a blob with refs, the count can only drop now
+        if (blob->pins.load(std::memory_order_acquire) > 0)
+        {
+            retired.push_back(blob);
+        }
+        else
+        {
+            free(blob);
+        }
+        return cost;
+    }
+
+    // moves a blob to a new chunk, the caller updates the blob's only holder. Only blobs held by a
+    // single node and not pinned can move.
+    ValueBlob *relocate(ValueBlob *blob)
+    {
+        ValueBlob *moved = static_cast<ValueBlob *>(slab.allocate(sizeof(ValueBlob) + blob->len));
+        moved->hash = blob->hash;
+        moved->nextSameHash = blob->nextSameHash;
+        moved->refs = blob->refs;
+        moved->len = blob->len;
+        moved->rawLen = blob->rawLen;
+        moved->cost = blob->cost;
+        new (&moved->pins) std::atomic<uint32_t>(0);
+        moved->owner = blob->owner;
+        memcpy(moved->bytes(), blob->bytes(), blob->len);
+
+        if (dedup)
+        {
+            ValueBlob **link = &pooled.find(blob->hash)->second;
+            while (*link != blob)
+            {
+                link = &(*link)->nextSameHash;
+            }
+            *link = moved;
+        }
+
+        free(blob);
+        return moved;
+    }
+
+    // pins a blob still referenced by a node
+    static void pin(ValueBlob *blob)
+    {
+        blob->pins.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // drops a pin, safe without the lock
+    static void unpin(ValueBlob *blob)
+    {
+        blob->pins.fetch_sub(1, std::memory_order_release);
+    }
+
+    // frees the retired blobs no reader pins anymore, returns the number freed
+    size_t collect()
+    {
+        size_t freed = 0;
+        for (size_t i = 0; i < retired.size();)
+        {
+            if (retired[i]->pins.load(std::memory_order_acquire) == 0)
+            {
+                free(retired[i]);
+                retired[i] = retired.back();
+                retired.pop_back();
+                freed++;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        return freed;
+    }
+
+    // number of released blobs waiting for their readers
+    size_t retiredCount() const
+    {
+        return retired.size();
+    }
+};
+
+#endif